@@ -0,0 +1,1606 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <stddef.h>
+#include <limits.h>
+#include <stdint.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "anneal.h"
+#include "bitset.h"
+#include "movebatch.h"
+
+void rng_seed(Rng *rng, uint64_t seed)
+{
+    // splitmix64 so that nearby seeds give unrelated streams
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    rng->s = z != 0 ? z : 1;
+}
+
+uint64_t rng_next(Rng *rng)
+{
+    rng->s ^= rng->s >> 12;
+    rng->s ^= rng->s << 25;
+    rng->s ^= rng->s >> 27;
+    return rng->s * 0x2545F4914F6CDD1DULL;
+}
+
+size_t rng_below(Rng *rng, size_t n)
+{
+    return (size_t)(rng_next(rng) % n);
+}
+
+// uniform in [0, 1)
+double rng_double(Rng *rng)
+{
+    return (rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// r rooms that just hold n staffs, allocated with their names from arena
+Room *gen_rooms(size_t r, size_t n, Arena *arena)
+{
+    size_t cap = ceil((double)n / r);
+    Room *rooms = (Room *)arena_alloc(arena, sizeof(Room) * r);
+    if (rooms == NULL)
+        return NULL;
+    for (size_t i = 0; i < r; i++)
+    {
+        char name[32];
+        sprintf(name, "Room %zu", i);
+        rooms[i].name = arena_strdup(arena, name);
+        rooms[i].cap = cap;
+        if (rooms[i].name == NULL)
+            return NULL;
+    }
+    return rooms;
+}
+
+int min_int(int a, int b)
+{
+    return a < b ? a : b;
+}
+
+void shuffle_int_arr(Rng *rng, int *arr, int n)
+{
+    for (int i = n - 1; i > 0; i--)
+    {
+        int j = (int)rng_below(rng, i + 1);
+        int temp = arr[i];
+        arr[i] = arr[j];
+        arr[j] = temp;
+    }
+}
+
+int greedy_init(GreedyState *g, const Room *rooms, size_t num_rooms, size_t n)
+{
+    g->n_rooms = num_rooms;
+    g->n_staffs = n;
+    g->n_classes = 0;
+    arena_init(&g->arena, 0);
+    g->cap_class = (size_t *)arena_alloc(&g->arena, sizeof(size_t) * num_rooms);
+    g->pair_total = (int64_t *)arena_calloc(&g->arena, n, sizeof(int64_t));
+    g->assigned = (int *)arena_calloc(&g->arena, n * num_rooms, sizeof(int));
+    g->class_count = (int *)arena_calloc(&g->arena, n * num_rooms, sizeof(int));
+    g->acc = (int *)arena_calloc(&g->arena, num_rooms, sizeof(int));
+    g->member_sum = (int64_t *)arena_calloc(&g->arena, num_rooms, sizeof(int64_t));
+    if (g->cap_class == NULL || g->pair_total == NULL || g->assigned == NULL || g->class_count == NULL ||
+        g->acc == NULL || g->member_sum == NULL)
+        return 2;
+
+    // rooms of equal capacity share a class, numbered in order of first appearance
+    for (size_t k = 0; k < num_rooms; k++)
+    {
+        size_t j = 0;
+        while (j < k && rooms[j].cap != rooms[k].cap)
+        {
+            j++;
+        }
+        g->cap_class[k] = j < k ? g->cap_class[j] : g->n_classes++;
+    }
+    return 0;
+}
+
+void greedy_free(GreedyState *g)
+{
+    arena_free(&g->arena);
+}
+
+// forget the room contents of the previous section
+void greedy_next_section(GreedyState *g)
+{
+    memset(g->member_sum, 0, sizeof(int64_t) * g->n_rooms);
+}
+
+int64_t weight_fn(const GreedyState *g, int staff, size_t room_id, size_t room_size)
+{
+    const int64_t REASSIGN_BONUS = 10000000;
+    int64_t paired_penalty = g->pair_total[staff];
+    int64_t reassigned_penalty = g->assigned[staff * g->n_rooms + room_id] * REASSIGN_BONUS * 10;
+    int64_t reassigned_same_cap_penalty =
+        g->class_count[staff * g->n_rooms + g->cap_class[room_id]] * REASSIGN_BONUS;
+    int64_t cap_penalty = REASSIGN_BONUS * 100 * (int64_t)(room_size < g->n_staffs ? room_size : g->n_staffs);
+    int64_t acc_penalty = (g->acc[room_id] + g->member_sum[room_id]) * REASSIGN_BONUS;
+    return paired_penalty + cap_penalty + reassigned_penalty + reassigned_same_cap_penalty + acc_penalty;
+}
+
+// record staff joining room_id, whose current size is room_size
+void greedy_assign(GreedyState *g, const int *members, size_t room_size, size_t room_id, int staff)
+{
+    g->pair_total[staff] += room_size;
+    for (size_t p = 0; p < room_size; p++)
+    {
+        g->pair_total[members[p]]++;
+    }
+    g->assigned[staff * g->n_rooms + room_id]++;
+    g->class_count[staff * g->n_rooms + g->cap_class[room_id]]++;
+    g->acc[room_id]++;
+    g->member_sum[room_id] += staff;
+}
+
+int timetable_init(Timetable *tt, size_t n_secs, size_t n_rooms, size_t n_staffs, size_t cap)
+{
+    tt->n_secs = n_secs;
+    tt->n_rooms = n_rooms;
+    tt->n_staffs = n_staffs;
+    tt->cap = cap;
+    // one block, released as a whole by timetable_free
+    tt->occupancy = (size_t *)calloc(1, sizeof(size_t) * n_secs * n_rooms +
+                                            sizeof(int) * (n_secs * n_rooms * cap + 2 * n_secs * n_staffs));
+    if (tt->occupancy == NULL)
+    {
+        tt->slots = tt->room_of = tt->slot_of = NULL;
+        return 2;
+    }
+    tt->slots = (int *)(tt->occupancy + n_secs * n_rooms);
+    tt->room_of = tt->slots + n_secs * n_rooms * cap;
+    tt->slot_of = tt->room_of + n_secs * n_staffs;
+    for (size_t i = 0; i < n_secs * n_rooms * cap; i++)
+    {
+        tt->slots[i] = NO_ASSIGN;
+    }
+    for (size_t i = 0; i < n_secs * n_staffs; i++)
+    {
+        tt->room_of[i] = NO_ASSIGN;
+        tt->slot_of[i] = NO_ASSIGN;
+    }
+    return 0;
+}
+
+void timetable_free(Timetable *tt)
+{
+    free(tt->occupancy);
+    tt->occupancy = NULL;
+}
+
+// copy the assignment of src into dst, both must have the same shape
+void timetable_copy(Timetable *dst, const Timetable *src)
+{
+    memcpy(dst->slots, src->slots, sizeof(int) * src->n_secs * src->n_rooms * src->cap);
+    memcpy(dst->occupancy, src->occupancy, sizeof(size_t) * src->n_secs * src->n_rooms);
+    memcpy(dst->room_of, src->room_of, sizeof(int) * src->n_secs * src->n_staffs);
+    memcpy(dst->slot_of, src->slot_of, sizeof(int) * src->n_secs * src->n_staffs);
+}
+
+int *room_staffs(const Timetable *tt, size_t sec, size_t room)
+{
+    return tt->slots + (sec * tt->n_rooms + room) * tt->cap;
+}
+
+size_t room_size(const Timetable *tt, size_t sec, size_t room)
+{
+    return tt->occupancy[sec * tt->n_rooms + room];
+}
+
+void assign(Timetable *tt, size_t sec, size_t room, int staff)
+{
+    size_t *occ = tt->occupancy + sec * tt->n_rooms + room;
+    assert(*occ < tt->cap);
+    room_staffs(tt, sec, room)[*occ] = staff;
+    tt->room_of[sec * tt->n_staffs + staff] = room;
+    tt->slot_of[sec * tt->n_staffs + staff] = *occ;
+    (*occ)++;
+}
+
+// unseat everyone in section sec
+void clear_section(Timetable *tt, size_t sec)
+{
+    for (size_t k = 0; k < tt->n_rooms; k++)
+    {
+        int *staffs = room_staffs(tt, sec, k);
+        for (size_t p = 0; p < tt->cap; p++)
+        {
+            staffs[p] = NO_ASSIGN;
+        }
+        tt->occupancy[sec * tt->n_rooms + k] = 0;
+    }
+    for (size_t s = 0; s < tt->n_staffs; s++)
+    {
+        tt->room_of[sec * tt->n_staffs + s] = NO_ASSIGN;
+        tt->slot_of[sec * tt->n_staffs + s] = NO_ASSIGN;
+    }
+}
+
+// exchange the places of staff l and r in section sec
+void swap_staffs(Timetable *tt, size_t sec, int l, int r)
+{
+    size_t il = sec * tt->n_staffs + l, ir = sec * tt->n_staffs + r;
+    int rl = tt->room_of[il], sl = tt->slot_of[il];
+    int rr = tt->room_of[ir], sr = tt->slot_of[ir];
+    room_staffs(tt, sec, rl)[sl] = r;
+    room_staffs(tt, sec, rr)[sr] = l;
+    tt->room_of[il] = rr;
+    tt->slot_of[il] = sr;
+    tt->room_of[ir] = rl;
+    tt->slot_of[ir] = sl;
+}
+
+// take staff out of its room in section sec and add it to room `to`; the
+// last member of the old room fills the gap
+void relocate_staff(Timetable *tt, size_t sec, int staff, size_t to)
+{
+    size_t is = sec * tt->n_staffs + staff;
+    int from = tt->room_of[is], slot = tt->slot_of[is];
+    int *members = room_staffs(tt, sec, from);
+    size_t *occ = tt->occupancy + sec * tt->n_rooms + from;
+    int last = members[--(*occ)];
+    members[slot] = last;
+    tt->slot_of[sec * tt->n_staffs + last] = slot;
+    assign(tt, sec, to, staff);
+}
+
+void apply_move(Timetable *tt, const Move *m)
+{
+    if (m->r == NO_ASSIGN)
+        relocate_staff(tt, m->sec, m->l, m->b);
+    else
+        swap_staffs(tt, m->sec, m->l, m->r);
+}
+
+int solve(const Room *rooms, size_t num_rooms, int t, int n, Timetable *tt)
+{
+    return solve_from(rooms, num_rooms, t, n, NULL, NULL, tt);
+}
+
+// solve() continuing a schedule whose earlier sections put staff s in room k
+// history[s * num_rooms + k] times, history may be NULL. With eligible, staffs
+// are only seated in the sections they are available in and in rooms they
+// are qualified for, those with the fewest rooms first. Staffs are otherwise
+// seated in index order, so the result is deterministic; randomness enters
+// only through simulated_annealing().
+int solve_from(const Room *rooms, size_t num_rooms, int t, int n, const size_t *history, const Eligibility *eligible,
+               Timetable *tt)
+{
+    size_t cap = 0;
+    for (size_t k = 0; k < num_rooms; k++)
+    {
+        if (rooms[k].cap > cap)
+            cap = rooms[k].cap;
+    }
+    if (timetable_init(tt, t, num_rooms, n, cap) != 0)
+        return 2;
+
+    GreedyState g;
+    int *staffs = NULL;
+    if (greedy_init(&g, rooms, num_rooms, n) != 0 ||
+        (staffs = (int *)arena_alloc(&g.arena, n * sizeof(int))) == NULL)
+    {
+        greedy_free(&g);
+        timetable_free(tt);
+        return 2;
+    }
+    if (history != NULL)
+    {
+        for (int s = 0; s < n; s++)
+        {
+            for (size_t k = 0; k < num_rooms; k++)
+            {
+                int v = (int)history[s * num_rooms + k];
+                g.assigned[s * num_rooms + k] += v;
+                g.class_count[s * num_rooms + g.cap_class[k]] += v;
+                g.acc[k] += v;
+            }
+        }
+    }
+
+    int ret = 0;
+    for (int i = 0; i < t && ret == 0; i++)
+    {
+        greedy_next_section(&g);
+        for (int j = 0; j < n; j++)
+        {
+            staffs[j] = j;
+        }
+        if (eligible != NULL)
+        {
+            // insertion sort by the number of rooms, stable so the order is otherwise kept
+            for (int j = 1; j < n; j++)
+            {
+                int staff = staffs[j], p = j;
+                for (; p > 0 && eligible_rooms(eligible, staffs[p - 1]) > eligible_rooms(eligible, staff); p--)
+                {
+                    staffs[p] = staffs[p - 1];
+                }
+                staffs[p] = staff;
+            }
+        }
+
+        for (int j = 0; j < n; j++)
+        {
+            int staff = staffs[j];
+            if (!eligible_section(eligible, staff, i))
+                continue;
+
+            int picked_room_id = -1;
+            int64_t min_penalty = INT64_MAX;
+            for (size_t room_id = 0; room_id < num_rooms; room_id++)
+            {
+                size_t sz = room_size(tt, i, room_id);
+                if (sz < rooms[room_id].cap && eligible_room(eligible, staff, room_id))
+                {
+                    int64_t penalty = weight_fn(&g, staff, room_id, sz);
+                    if (penalty < min_penalty)
+                    {
+                        min_penalty = penalty;
+                        picked_room_id = room_id;
+                    }
+                }
+            }
+
+            if (picked_room_id == -1)
+            {
+                // the rooms, or those the staff is qualified for, cannot hold everyone
+                ret = 1;
+                break;
+            }
+
+            greedy_assign(&g, room_staffs(tt, i, picked_room_id), room_size(tt, i, picked_room_id), picked_room_id, staff);
+            assign(tt, i, picked_room_id, staff);
+        }
+    }
+
+    greedy_free(&g);
+    if (ret != 0)
+        timetable_free(tt);
+
+    return ret;
+}
+
+size_t energy(const Timetable *tt)
+{
+    return visit_energy(tt, NULL);
+}
+
+// the visit term of energy() with the visits of earlier sections, history[s * n_rooms + k], added in
+size_t visit_energy(const Timetable *tt, const size_t *history)
+{
+    size_t acc = 0;
+    size_t len = tt->n_rooms;
+    size_t *count = (size_t *)calloc(len, sizeof(size_t));
+    for (size_t s = 0; s < tt->n_staffs; s++)
+    {
+        if (history != NULL)
+            memcpy(count, history + s * len, sizeof(size_t) * len);
+        for (size_t j = 0; j < tt->n_secs; j++)
+        {
+            int k = tt->room_of[j * tt->n_staffs + s];
+            if (k != NO_ASSIGN)
+                count[k]++;
+        }
+        for (size_t k = 0; k < len; k++)
+        {
+            acc += count[k] * count[k];
+        }
+        // reset count
+        for (size_t k = 0; k < len; k++)
+        {
+            count[k] = 0;
+        }
+    }
+
+    free(count);
+
+    return acc;
+}
+
+size_t section_cost(const Timetable *tt, const Room *rooms, size_t sec)
+{
+    int mn = -1, mx = -1;
+    for (size_t j = 0; j < tt->n_rooms; j++)
+    {
+        size_t tmp = rooms[j].cap - room_size(tt, sec, j);
+        if (mn == -1 || tmp < mn)
+            mn = tmp;
+        if (mx == -1 || tmp > mx)
+            mx = tmp;
+    }
+    return mx * (mx - mn);
+}
+
+size_t energy2(const Timetable *tt, const Room *rooms)
+{
+    return energy2_after(tt, rooms, NULL);
+}
+
+// energy2 of tt as the continuation of the sections counted in history, which may be NULL
+size_t energy2_after(const Timetable *tt, const Room *rooms, const size_t *history)
+{
+    size_t acc = visit_energy(tt, history);
+
+    for (size_t i = 0; i < tt->n_secs; i++)
+    {
+        acc += section_cost(tt, rooms, i);
+    }
+
+    return acc;
+}
+
+// Lower bound on the visit term. Moves never change which sections a staff
+// is seated in, so the a sections of staff s are only spread differently
+// over the rooms it is qualified for; the sum of squares is smallest when
+// every one goes to such a room the staff has visited least so far,
+// capacities aside.
+size_t visit_lower_bound(const Timetable *tt, const size_t *history, const Eligibility *eligible)
+{
+    size_t acc = 0;
+    size_t len = tt->n_rooms;
+    size_t *count = (size_t *)calloc(len, sizeof(size_t));
+    if (count == NULL)
+        return 0;
+    for (size_t s = 0; s < tt->n_staffs; s++)
+    {
+        size_t a = 0;
+        for (size_t j = 0; j < tt->n_secs; j++)
+        {
+            if (tt->room_of[j * tt->n_staffs + s] != NO_ASSIGN)
+                a++;
+        }
+        size_t allowed = eligible != NULL ? eligible_rooms(eligible, (int)s) : len;
+        if (history == NULL && allowed > 0)
+        {
+            // a perfectly balanced spread
+            size_t q = a / allowed, rem = a % allowed;
+            acc += rem * (q + 1) * (q + 1) + (allowed - rem) * q * q;
+            continue;
+        }
+        if (history != NULL)
+            memcpy(count, history + s * len, sizeof(size_t) * len);
+        else
+            memset(count, 0, sizeof(size_t) * len);
+        for (size_t i = 0; i < a && allowed > 0; i++)
+        {
+            size_t k_min = len;
+            for (size_t k = 0; k < len; k++)
+            {
+                if (eligible_room(eligible, (int)s, k) && (k_min == len || count[k] < count[k_min]))
+                    k_min = k;
+            }
+            count[k_min]++;
+        }
+        for (size_t k = 0; k < len; k++)
+        {
+            acc += count[k] * count[k];
+        }
+    }
+    free(count);
+    return acc;
+}
+
+// Lower bound on section_cost() for a section that seats `seated` staffs.
+// The free seats of the rooms add up to the total capacity minus seated;
+// their maximum is at least the smallest level m at which rooms holding
+// min(cap, m) free seats each can take them all, and their minimum is at
+// most the balanced share and at most the smallest capacity.
+size_t section_lower_bound(const Room *rooms, size_t n_rooms, size_t seated)
+{
+    size_t total = 0, min_cap = SIZE_MAX, max_cap = 0;
+    for (size_t k = 0; k < n_rooms; k++)
+    {
+        total += rooms[k].cap;
+        if ((size_t)rooms[k].cap < min_cap)
+            min_cap = rooms[k].cap;
+        if ((size_t)rooms[k].cap > max_cap)
+            max_cap = rooms[k].cap;
+    }
+    if (n_rooms == 0 || seated > total)
+        return 0;
+    size_t free_seats = total - seated;
+    size_t lo = (free_seats + n_rooms - 1) / n_rooms, hi = max_cap;
+    while (lo < hi)
+    {
+        size_t m = lo + (hi - lo) / 2, fits = 0;
+        for (size_t k = 0; k < n_rooms; k++)
+        {
+            fits += (size_t)rooms[k].cap < m ? (size_t)rooms[k].cap : m;
+        }
+        if (fits >= free_seats)
+            hi = m;
+        else
+            lo = m + 1;
+    }
+    size_t low = free_seats / n_rooms < min_cap ? free_seats / n_rooms : min_cap;
+    return lo * (lo - low);
+}
+
+// Lower bound on energy2_after(): no timetable the annealer's moves can reach
+// from tt scores less.
+size_t energy2_lower_bound(const Timetable *tt, const Room *rooms, const size_t *history, const Eligibility *eligible)
+{
+    size_t acc = visit_lower_bound(tt, history, eligible);
+    for (size_t i = 0; i < tt->n_secs; i++)
+    {
+        size_t seated = 0;
+        for (size_t k = 0; k < tt->n_rooms; k++)
+        {
+            seated += room_size(tt, i, k);
+        }
+        acc += section_lower_bound(rooms, tt->n_rooms, seated);
+    }
+    return acc;
+}
+
+// relative distance of an energy from a lower bound, 0 when it is optimal
+double energy_gap(size_t energy, size_t bound)
+{
+    if (energy <= bound)
+        return 0;
+    return (double)(energy - bound) / (double)energy;
+}
+
+void undo_moves(Timetable *tt, const Move *moves, size_t moves_len)
+{
+    for (size_t i = moves_len; i-- > 0;)
+    {
+        if (moves[i].r == NO_ASSIGN)
+            relocate_staff(tt, moves[i].sec, moves[i].l, moves[i].a);
+        else
+            swap_staffs(tt, moves[i].sec, moves[i].l, moves[i].r);
+    }
+}
+
+void neighborhood_init(Neighborhood *nb)
+{
+    for (size_t op = 0; op < N_OPS; op++)
+    {
+        nb->weight[op] = 1;
+        nb->score[op] = 0;
+        nb->uses[op] = 0;
+    }
+    nb->steps = 0;
+    nb->last = OP_SWAP;
+}
+
+// Reward the operator of the last move and, at the end of every segment,
+// move the operator weights towards their average reward.
+void neighborhood_feedback(Neighborhood *nb, long long delta, int accepted)
+{
+    const size_t SEGMENT = 200;
+    const double REACTION = 0.2, MIN_WEIGHT = 0.05;
+    nb->score[nb->last] += delta < 0 ? 3 : accepted ? 1 : 0;
+    nb->uses[nb->last]++;
+    if (++nb->steps % SEGMENT != 0)
+        return;
+    for (size_t op = 0; op < N_OPS; op++)
+    {
+        if (nb->uses[op] != 0)
+            nb->weight[op] = (1 - REACTION) * nb->weight[op] + REACTION * nb->score[op] / nb->uses[op];
+        if (nb->weight[op] < MIN_WEIGHT)
+            nb->weight[op] = MIN_WEIGHT;
+        nb->score[op] = 0;
+        nb->uses[op] = 0;
+    }
+}
+
+// roulette-wheel choice of an operator by weight
+NeighborOp pick_op(const Neighborhood *nb, Rng *rng)
+{
+    double total = 0;
+    for (size_t op = 0; op < N_OPS; op++)
+    {
+        total += nb->weight[op];
+    }
+    double x = rng_double(rng) * total;
+    for (size_t op = 0; op + 1 < N_OPS; op++)
+    {
+        if (x < nb->weight[op])
+            return (NeighborOp)op;
+        x -= nb->weight[op];
+    }
+    return (NeighborOp)(N_OPS - 1);
+}
+
+// Sample a staff and section, preferring staff that sit in a room they visit
+// often, which is where the visit term of energy comes from.
+int pick_hot(const Timetable *tt, const EnergyState *st, Rng *rng, size_t *sec, int *staff)
+{
+    const size_t SAMPLES = 3;
+    size_t best_v = 0;
+    int found = 0;
+    for (size_t k = 0; k < SAMPLES; k++)
+    {
+        size_t i = rng_below(rng, tt->n_secs);
+        int s = (int)rng_below(rng, tt->n_staffs);
+        int room = tt->room_of[i * tt->n_staffs + s];
+        if (room == NO_ASSIGN)
+            continue;
+        size_t v = st->visits[s * tt->n_rooms + room];
+        if (!found || v > best_v)
+        {
+            best_v = v;
+            *sec = i;
+            *staff = s;
+            found = 1;
+        }
+    }
+    return found ? 0 : -1;
+}
+
+// A room of section sec other than `from` that staff s has rarely visited, is
+// qualified for and that is non-empty, NO_ASSIGN when none was found.
+int pick_target(const Timetable *tt, const EnergyState *st, Rng *rng, size_t sec, int s, int from)
+{
+    const size_t SAMPLES = 2;
+    int best = NO_ASSIGN;
+    size_t max_retry = 16;
+    for (size_t k = 0; k < SAMPLES && max_retry--;)
+    {
+        int b = (int)rng_below(rng, tt->n_rooms);
+        if (b == from || room_size(tt, sec, b) == 0 || !eligible_room(st->eligible, s, b))
+            continue;
+        k++;
+        if (best == NO_ASSIGN || st->visits[s * tt->n_rooms + b] < st->visits[s * tt->n_rooms + best])
+            best = b;
+    }
+    return best;
+}
+
+// A member of room b in section sec that is qualified for room `to`,
+// preferring one that visits b often, NO_ASSIGN when neither sample is.
+int pick_partner(const Timetable *tt, const EnergyState *st, Rng *rng, size_t sec, int b, int to)
+{
+    const int *members = room_staffs(tt, sec, b);
+    size_t len = room_size(tt, sec, b);
+    int x = members[rng_below(rng, len)], y = members[rng_below(rng, len)];
+    if (!eligible_room(st->eligible, x, to))
+        x = y;
+    else if (!eligible_room(st->eligible, y, to))
+        y = x;
+    if (!eligible_room(st->eligible, x, to))
+        return NO_ASSIGN;
+    return st->visits[y * tt->n_rooms + b] > st->visits[x * tt->n_rooms + b] ? y : x;
+}
+
+// Rotate staff s of section sec and up to len - 1 others: s leaves its room
+// for a room it rarely visits, the staff it displaces takes its place and
+// moves on in the same way, and the last displaced staff takes s's old room.
+void chain_moves(Timetable *tt, const EnergyState *st, Rng *rng, size_t sec, int s, size_t len, Move *moves, size_t *moves_len)
+{
+    int a = tt->room_of[sec * tt->n_staffs + s];
+    // s is not seated in sec
+    if (a == NO_ASSIGN)
+        return;
+    for (size_t k = 0; k < len && *moves_len < MAX_MOVES; k++)
+    {
+        int b = pick_target(tt, st, rng, sec, s, a);
+        if (b == NO_ASSIGN)
+            return;
+        int r = pick_partner(tt, st, rng, sec, b, a);
+        if (r == NO_ASSIGN)
+            return;
+        Move *m = moves + *moves_len;
+        m->sec = sec;
+        m->a = a;
+        m->b = b;
+        m->l = s;
+        m->r = r;
+        apply_move(tt, m);
+        (*moves_len)++;
+        // the displaced staff now sits in room a
+        s = m->r;
+    }
+}
+
+// Exchange the rooms of staff s between section sec and another section in
+// which it sits elsewhere: in sec s swaps with a member of its other room b,
+// in the other section with a member of room a. The visits of s stay the
+// same and only the two partners change room, which a single swap of s
+// could not do without changing s's visit term.
+void cross_move(Timetable *tt, const EnergyState *st, Rng *rng, size_t sec, int s, Move *moves, size_t *moves_len)
+{
+    const size_t SAMPLES = 4;
+    int a = tt->room_of[sec * tt->n_staffs + s];
+    if (a == NO_ASSIGN || tt->n_secs < 2)
+        return;
+    for (size_t k = 0; k < SAMPLES; k++)
+    {
+        size_t other = rng_below(rng, tt->n_secs - 1);
+        other = other < sec ? other : other + 1;
+        int b = tt->room_of[other * tt->n_staffs + s];
+        // each section needs a partner in the room s moves to
+        if (b == NO_ASSIGN || b == a || room_size(tt, sec, b) == 0 || room_size(tt, other, a) == 0)
+            continue;
+        int r = pick_partner(tt, st, rng, sec, b, a);
+        int q = pick_partner(tt, st, rng, other, a, b);
+        if (r == NO_ASSIGN || q == NO_ASSIGN)
+            continue;
+        Move *m = moves + (*moves_len)++;
+        m->sec = sec;
+        m->a = a;
+        m->b = b;
+        m->l = s;
+        m->r = r;
+        apply_move(tt, m);
+        m = moves + (*moves_len)++;
+        m->sec = other;
+        m->a = b;
+        m->b = a;
+        m->l = s;
+        m->r = q;
+        apply_move(tt, m);
+        return;
+    }
+}
+
+// move one staff of a crowded room of a section into the emptiest room that has space
+void relocate_move(Timetable *tt, const EnergyState *st, const Room *rooms, Rng *rng, Move *moves, size_t *moves_len)
+{
+    const size_t SAMPLES = 2;
+    size_t sec = rng_below(rng, tt->n_secs);
+    size_t other = rng_below(rng, tt->n_secs);
+    if (st->sec_cost[other] > st->sec_cost[sec])
+        sec = other;
+
+    int a = NO_ASSIGN, b = NO_ASSIGN;
+    long long a_slack = 0, b_slack = 0;
+    for (size_t k = 0; k < SAMPLES * 2; k++)
+    {
+        int x = (int)rng_below(rng, tt->n_rooms);
+        long long sz = (long long)room_size(tt, sec, x);
+        long long slack = rooms[x].cap - sz;
+        if (sz > 0 && (a == NO_ASSIGN || slack < a_slack))
+        {
+            a = x;
+            a_slack = slack;
+        }
+        if (slack > 0 && (b == NO_ASSIGN || slack > b_slack))
+        {
+            b = x;
+            b_slack = slack;
+        }
+    }
+    // only a move towards more slack can even out the section
+    if (a == NO_ASSIGN || b == NO_ASSIGN || a == b || b_slack <= a_slack + 1)
+        return;
+
+    const int *members = room_staffs(tt, sec, a);
+    size_t len = room_size(tt, sec, a);
+    int x = members[rng_below(rng, len)], y = members[rng_below(rng, len)];
+    if (!eligible_room(st->eligible, x, b))
+        x = y;
+    else if (!eligible_room(st->eligible, y, b))
+        y = x;
+    if (!eligible_room(st->eligible, x, b))
+        return;
+    // the staff that gains most from leaving a for b
+    long long gain_x = (long long)st->visits[x * tt->n_rooms + a] - (long long)st->visits[x * tt->n_rooms + b];
+    long long gain_y = (long long)st->visits[y * tt->n_rooms + a] - (long long)st->visits[y * tt->n_rooms + b];
+
+    Move *m = moves + (*moves_len)++;
+    m->sec = sec;
+    m->a = a;
+    m->b = b;
+    m->l = gain_y > gain_x ? y : x;
+    m->r = NO_ASSIGN;
+    apply_move(tt, m);
+}
+
+// Modify tt in place with an operator picked by nb; the primitive moves done
+// are recorded in moves so they can be undone. The operators are
+//
+//   OP_SWAP      exchange a frequently seated staff with a member of a room it rarely visits
+//   OP_RELOCATE  move a staff from a full room into one with more spare capacity
+//   OP_CROSS     a staff's rooms in two sections exchanged, see cross_move()
+//   OP_CHAIN     a rotation of up to MAX_MOVES staff through rooms of one section
+int neighbor(Timetable *tt, const EnergyState *st, const Room *rooms, Neighborhood *nb, Rng *rng, Move *moves, size_t *moves_len)
+{
+    *moves_len = 0;
+    if (tt->n_rooms < 2)
+        return -1;
+
+    NeighborOp op = pick_op(nb, rng);
+    nb->last = op;
+    if (op == OP_RELOCATE)
+    {
+        relocate_move(tt, st, rooms, rng, moves, moves_len);
+        return 0;
+    }
+
+    size_t sec;
+    int s;
+    if (pick_hot(tt, st, rng, &sec, &s) != 0)
+        return 0;
+    if (op == OP_SWAP)
+    {
+        chain_moves(tt, st, rng, sec, s, 1, moves, moves_len);
+    }
+    else if (op == OP_CHAIN)
+    {
+        chain_moves(tt, st, rng, sec, s, 2 + rng_below(rng, MAX_MOVES - 1), moves, moves_len);
+    }
+    else
+    {
+        cross_move(tt, st, rng, sec, s, moves, moves_len);
+    }
+    return 0;
+}
+
+// history, if not NULL, holds the visits of earlier sections and must outlive
+// st, as must eligible
+int energy_state_init(EnergyState *st, const Timetable *tt, const Room *rooms, const size_t *history,
+                      const Eligibility *eligible)
+{
+    st->history = history;
+    st->eligible = eligible;
+    st->visits = (size_t *)calloc(tt->n_staffs * tt->n_rooms, sizeof(size_t));
+    st->sec_cost = (size_t *)calloc(tt->n_secs, sizeof(size_t));
+    if (st->visits == NULL || st->sec_cost == NULL)
+        return 2;
+    if (history != NULL)
+        memcpy(st->visits, history, sizeof(size_t) * tt->n_staffs * tt->n_rooms);
+
+    for (size_t i = 0; i < tt->n_secs; i++)
+    {
+        for (size_t s = 0; s < tt->n_staffs; s++)
+        {
+            int k = tt->room_of[i * tt->n_staffs + s];
+            if (k != NO_ASSIGN)
+                st->visits[s * tt->n_rooms + k]++;
+        }
+    }
+
+    st->total = 0;
+    for (size_t s = 0; s < tt->n_staffs * tt->n_rooms; s++)
+    {
+        st->total += st->visits[s] * st->visits[s];
+    }
+    for (size_t i = 0; i < tt->n_secs; i++)
+    {
+        st->sec_cost[i] = section_cost(tt, rooms, i);
+        st->total += st->sec_cost[i];
+    }
+    return 0;
+}
+
+void energy_state_free(EnergyState *st)
+{
+    free(st->visits);
+    free(st->sec_cost);
+}
+
+// staff left room `from` for room `to` in some section, return the change of the visit term
+long long energy_state_visit(EnergyState *st, const Timetable *tt, int staff, size_t from, size_t to)
+{
+    size_t *v = st->visits + staff * tt->n_rooms;
+    // (v_from - 1)^2 - v_from^2 + (v_to + 1)^2 - v_to^2
+    long long delta = 2 * ((long long)v[to] - (long long)v[from]) + 2;
+    v[from]--;
+    v[to]++;
+    return delta;
+}
+
+// recompute the capacity term of section sec, return its change
+long long energy_state_section(EnergyState *st, const Timetable *tt, const Room *rooms, size_t sec)
+{
+    size_t cost = section_cost(tt, rooms, sec);
+    long long delta = (long long)cost - (long long)st->sec_cost[sec];
+    st->sec_cost[sec] = cost;
+    return delta;
+}
+
+long long energy_state_apply(EnergyState *st, const Timetable *tt, const Room *rooms, const Move *moves, size_t moves_len)
+{
+    long long delta = 0;
+    for (size_t i = 0; i < moves_len; i++)
+    {
+        delta += energy_state_visit(st, tt, moves[i].l, moves[i].a, moves[i].b);
+        if (moves[i].r != NO_ASSIGN)
+            delta += energy_state_visit(st, tt, moves[i].r, moves[i].b, moves[i].a);
+        delta += energy_state_section(st, tt, rooms, moves[i].sec);
+    }
+    st->total += delta;
+    return delta;
+}
+
+void energy_state_revert(EnergyState *st, const Timetable *tt, const Room *rooms, const Move *moves, size_t moves_len)
+{
+    long long delta = 0;
+    for (size_t i = moves_len; i-- > 0;)
+    {
+        if (moves[i].r != NO_ASSIGN)
+            delta += energy_state_visit(st, tt, moves[i].r, moves[i].a, moves[i].b);
+        delta += energy_state_visit(st, tt, moves[i].l, moves[i].b, moves[i].a);
+        delta += energy_state_section(st, tt, rooms, moves[i].sec);
+    }
+    st->total += delta;
+}
+
+// compare the incremental energy against energy2, and the visit counts
+// against the popcount kernels, every VERIFY_ENERGY steps
+// #define VERIFY_ENERGY 1000
+
+#ifdef VERIFY_ENERGY
+void verify_energy(const Timetable *tt, const Room *rooms, const EnergyState *st, size_t step)
+{
+    if (step % VERIFY_ENERGY != 0)
+        return;
+    size_t full = energy2_after(tt, rooms, st->history);
+    if (full != st->total)
+    {
+        fprintf(stderr, "energy mismatch at step %zu: incremental %zu, full %zu\n", step, st->total, full);
+        abort();
+    }
+    VisitBits vb;
+    if (visit_bits_from(&vb, tt) != 0)
+        return;
+    for (size_t s = 0; s < tt->n_staffs; s++)
+    {
+        for (size_t k = 0; k < tt->n_rooms; k++)
+        {
+            size_t i = s * tt->n_rooms + k;
+            size_t v = visit_bits_count(&vb, (int)s, k) + (st->history != NULL ? st->history[i] : 0);
+            if (v != st->visits[i])
+            {
+                fprintf(stderr, "visit mismatch at step %zu: staff %zu room %zu, incremental %zu, bits %zu\n", step,
+                        s, k, st->visits[i], v);
+                abort();
+            }
+        }
+    }
+    if (st->history == NULL && visit_bits_energy(&vb) != visit_energy(tt, NULL))
+    {
+        fprintf(stderr, "visit term mismatch at step %zu\n", step);
+        abort();
+    }
+    visit_bits_free(&vb);
+}
+#endif
+
+// one Metropolis step at the given temperature, return 1 if the move was kept
+int anneal_step(Timetable *tt, EnergyState *st, const Room *rooms, Neighborhood *nb, Rng *rng, double temperature, int *err)
+{
+    Move moves[MAX_MOVES];
+    size_t moves_len;
+    int r = neighbor(tt, st, rooms, nb, rng, moves, &moves_len);
+    if (r != 0)
+    {
+        *err = r;
+        return 0;
+    }
+    long long delta = energy_state_apply(st, tt, rooms, moves, moves_len);
+
+    double p = exp(-((double)delta) / temperature);
+
+    if (delta >= 0 && rng_double(rng) >= p)
+    {
+        undo_moves(tt, moves, moves_len);
+        energy_state_revert(st, tt, rooms, moves, moves_len);
+        neighborhood_feedback(nb, delta, 0);
+        return 0;
+    }
+    neighborhood_feedback(nb, delta, 1);
+    return 1;
+}
+
+void anneal_default_config(AnnealConfig *cfg)
+{
+    cfg->initial_accept = 0.8;
+    cfg->final_accept = 0.001;
+    cfg->samples = 256;
+    cfg->epoch = 0;
+    cfg->patience = 20;
+    cfg->max_reheats = 2;
+    cfg->reheat = 0.2;
+    cfg->max_steps = 0;
+    cfg->time_limit = 0;
+    cfg->gap_tolerance = 0;
+    cfg->cancel = NULL;
+    cfg->on_best = NULL;
+    cfg->user = NULL;
+    cfg->history = NULL;
+    cfg->eligible = NULL;
+    cfg->telemetry = NULL;
+    cfg->repair = NULL;
+    cfg->repair_user = NULL;
+    cfg->repair_every = 5;
+    cfg->batch = 0;
+    cfg->batch_best = 0;
+}
+
+// start temperature at which a typical uphill move is taken with probability cfg->initial_accept
+double calibrate_temperature(Timetable *tt, EnergyState *st, const Room *rooms, Neighborhood *nb, Rng *rng, const AnnealConfig *cfg, int *err)
+{
+    double sum = 0;
+    size_t uphill = 0;
+    for (size_t i = 0; i < cfg->samples; i++)
+    {
+        Move moves[MAX_MOVES];
+        size_t moves_len;
+        int r = neighbor(tt, st, rooms, nb, rng, moves, &moves_len);
+        if (r != 0)
+        {
+            *err = r;
+            return 1;
+        }
+        long long delta = energy_state_apply(st, tt, rooms, moves, moves_len);
+        undo_moves(tt, moves, moves_len);
+        energy_state_revert(st, tt, rooms, moves, moves_len);
+        if (delta > 0)
+        {
+            sum += delta;
+            uphill++;
+        }
+    }
+    if (uphill == 0)
+        return 1;
+    return -(sum / uphill) / log(cfg->initial_accept);
+}
+
+// cooling factor for the next epoch, slow while a moderate share of moves is accepted
+double cooling_factor(double acceptance)
+{
+    if (acceptance > 0.9)
+        return 0.5;
+    if (acceptance > 0.6)
+        return 0.9;
+    if (acceptance > 0.1)
+        return 0.97;
+    return 0.9;
+}
+
+// the time limit has passed or the caller cancelled the run
+int anneal_should_stop(const AnnealConfig *cfg, double start)
+{
+    if (cfg->cancel != NULL && *cfg->cancel)
+        return 1;
+    return cfg->time_limit > 0 && now_seconds() - start >= cfg->time_limit;
+}
+
+// Anneal tt under an adaptive schedule and leave the best state found in it.
+//
+// The start temperature comes from sampled move deltas. Every epoch the
+// temperature is multiplied by a factor chosen from the epoch's acceptance
+// rate. When the best energy has not improved for cfg->patience epochs, or
+// the temperature has fallen to where an increase of 1 is accepted with
+// probability cfg->final_accept, the search restarts from the best state at
+// cfg->reheat times the start temperature, at most cfg->max_reheats times.
+// The run also ends as soon as the best energy comes within
+// cfg->gap_tolerance of energy2_lower_bound(), so an optimal greedy schedule
+// is not annealed at all. With cfg->repair set, the current state is handed
+// to it every cfg->repair_every epochs as a large move. With cfg->batch > 1
+// every step scores that many swaps and relocations at once (movebatch.c)
+// in place of one neighbor() move. stats may be NULL.
+int simulated_annealing(Timetable *tt, const Room *rooms, Rng *rng, const AnnealConfig *cfg, AnnealStats *stats)
+{
+    double start = now_seconds();
+    EnergyState st;
+    Timetable best;
+    // timetable_init is skipped when energy_state_init fails
+    best.occupancy = NULL;
+    if (energy_state_init(&st, tt, rooms, cfg->history, cfg->eligible) != 0 ||
+        timetable_init(&best, tt->n_secs, tt->n_rooms, tt->n_staffs, tt->cap) != 0)
+    {
+        energy_state_free(&st);
+        timetable_free(&best);
+        return 2;
+    }
+    timetable_copy(&best, tt);
+    size_t best_e = st.total;
+    // the snapshot is only taken when the search is about to leave a best state
+    int at_best = 1;
+    size_t bound = energy2_lower_bound(tt, rooms, cfg->history, cfg->eligible);
+    int gap_closed = energy_gap(best_e, bound) <= cfg->gap_tolerance;
+
+    Neighborhood nb;
+    neighborhood_init(&nb);
+    int err = 0;
+    double t0 = gap_closed ? 0 : calibrate_temperature(tt, &st, rooms, &nb, rng, cfg, &err);
+    double t_stop = -1 / log(cfg->final_accept);
+    double temperature = t0;
+    size_t epoch = cfg->epoch != 0 ? cfg->epoch : tt->n_secs * tt->n_staffs;
+    if (epoch < 100)
+        epoch = 100;
+    size_t steps = 0, epochs = 0, reheats = 0, repairs = 0, stale = 0, total_accepted = 0;
+    int timed_out = 0;
+    TELEMETRY(Telemetry *tel = cfg->telemetry);
+    MoveBatch mb;
+    size_t evaluated = 0;
+    if (cfg->batch > 1 && move_batch_init(&mb, cfg->batch) != 0)
+        err = 2;
+#ifdef VERIFY_ENERGY
+    size_t step = 0;
+#endif
+
+    while (err == 0 && !gap_closed)
+    {
+        size_t accepted = 0;
+        size_t improved = 0;
+        for (size_t k = 0; k < epoch; k++)
+        {
+            Move moves[MAX_MOVES];
+            size_t moves_len = 0;
+            long long delta;
+            int keep;
+            if (cfg->batch > 1)
+            {
+                // the batch already applied the Metropolis rule
+                move_batch_fill(&mb, tt, &st, rooms, rng, cfg->batch);
+                move_batch_deltas(&mb);
+                evaluated += mb.len;
+                int pick = move_batch_pick(&mb, rng, temperature, cfg->batch_best);
+                if (pick >= 0)
+                {
+                    moves[moves_len++] = mb.moves[pick];
+                    apply_move(tt, moves);
+                }
+                delta = energy_state_apply(&st, tt, rooms, moves, moves_len);
+                keep = moves_len > 0;
+            }
+            else
+            {
+                int r = neighbor(tt, &st, rooms, &nb, rng, moves, &moves_len);
+                if (r != 0)
+                {
+                    err = r;
+                    break;
+                }
+                delta = energy_state_apply(&st, tt, rooms, moves, moves_len);
+                keep = delta <= 0 || rng_double(rng) < exp(-((double)delta) / temperature);
+                neighborhood_feedback(&nb, delta, keep);
+                evaluated++;
+            }
+            if (!keep)
+            {
+                undo_moves(tt, moves, moves_len);
+                energy_state_revert(&st, tt, rooms, moves, moves_len);
+            }
+            else
+            {
+                accepted++;
+                if (st.total < best_e)
+                {
+                    best_e = st.total;
+                    at_best = 1;
+                    improved = 1;
+                    if (cfg->on_best != NULL)
+                        cfg->on_best(tt, best_e, cfg->user);
+                    TELEMETRY(if (tel != NULL) {
+                        TelemetryPoint p = {now_seconds() - start, steps + k + 1, st.total, best_e, temperature,
+                                            (double)accepted / (k + 1)};
+                        telemetry_best(tel, &p);
+                    });
+                    if (energy_gap(best_e, bound) <= cfg->gap_tolerance)
+                    {
+                        gap_closed = 1;
+                        steps += k + 1;
+                        total_accepted += accepted;
+                        break;
+                    }
+                }
+                else if (at_best && st.total > best_e)
+                {
+                    timetable_copy(&best, tt);
+                    undo_moves(&best, moves, moves_len);
+                    at_best = 0;
+                }
+            }
+#ifdef VERIFY_ENERGY
+            verify_energy(tt, rooms, &st, ++step);
+#endif
+            // the clock and the cancel flag are polled within epochs so long epochs stay responsive
+            if ((k & 255) == 255 && anneal_should_stop(cfg, start))
+            {
+                timed_out = 1;
+                steps += k + 1;
+                break;
+            }
+        }
+        if (gap_closed)
+            break;
+        total_accepted += accepted;
+        if (err != 0 || timed_out)
+            break;
+        steps += epoch;
+        epochs++;
+        TELEMETRY(if (tel != NULL) {
+            TelemetryPoint p = {now_seconds() - start, steps, st.total, best_e, temperature, (double)accepted / epoch};
+            telemetry_point(tel, &p);
+        });
+
+        if ((cfg->max_steps != 0 && steps >= cfg->max_steps) || anneal_should_stop(cfg, start))
+        {
+            timed_out = 1;
+            break;
+        }
+
+        if (cfg->repair != NULL && epochs % cfg->repair_every == 0)
+        {
+            err = cfg->repair(tt, rooms, cfg->repair_user);
+            energy_state_free(&st);
+            if (err == 0 && energy_state_init(&st, tt, rooms, cfg->history, cfg->eligible) != 0)
+                err = 2;
+            if (err != 0)
+                break;
+            repairs++;
+            if (st.total < best_e)
+            {
+                best_e = st.total;
+                at_best = 1;
+                improved = 1;
+                if (cfg->on_best != NULL)
+                    cfg->on_best(tt, best_e, cfg->user);
+                if (energy_gap(best_e, bound) <= cfg->gap_tolerance)
+                {
+                    gap_closed = 1;
+                    break;
+                }
+            }
+        }
+
+        stale = improved ? 0 : stale + 1;
+        temperature *= cooling_factor((double)accepted / epoch);
+        if (stale >= cfg->patience || temperature < t_stop)
+        {
+            if (reheats == cfg->max_reheats)
+                break;
+            reheats++;
+            stale = 0;
+            temperature = t0 * cfg->reheat;
+            if (!at_best)
+            {
+                timetable_copy(tt, &best);
+                energy_state_free(&st);
+                if (energy_state_init(&st, tt, rooms, cfg->history, cfg->eligible) != 0)
+                    err = 2;
+                at_best = 1;
+            }
+        }
+    }
+
+    if (err == 0 && !at_best)
+        timetable_copy(tt, &best);
+    if (cfg->telemetry != NULL)
+    {
+        telemetry_phase(cfg->telemetry, PHASE_ANNEAL, now_seconds() - start);
+        cfg->telemetry->steps += steps;
+        cfg->telemetry->accepted += total_accepted;
+        cfg->telemetry->epochs += epochs;
+        telemetry_stat(cfg->telemetry, "lower_bound", (double)bound);
+        telemetry_stat(cfg->telemetry, "gap", energy_gap(best_e, bound));
+    }
+    if (stats != NULL)
+    {
+        stats->steps = steps;
+        stats->accepted = total_accepted;
+        stats->epochs = epochs;
+        stats->reheats = reheats;
+        stats->repairs = repairs;
+        stats->evaluated = evaluated;
+        stats->t0 = t0;
+        stats->t_final = temperature;
+        stats->best_energy = best_e;
+        stats->lower_bound = bound;
+        stats->gap = energy_gap(best_e, bound);
+        stats->seconds = now_seconds() - start;
+        stats->timed_out = timed_out;
+        stats->gap_closed = gap_closed;
+    }
+
+    energy_state_free(&st);
+    timetable_free(&best);
+    if (cfg->batch > 1)
+        move_batch_free(&mb);
+
+    return err;
+}
+
+// Rolling-horizon form of solve() followed by simulated_annealing() for long
+// schedules. Windows of `window` sections are built and annealed one after
+// the other, each as the continuation of the sections fixed before it: the
+// room visits of those sections are carried forward as cfg->history, so the
+// visit term still spreads every staff over all rooms across the whole
+// horizon. The first window - overlap sections of a window are fixed and the
+// rest are built again as the start of the next window. The cost of a step
+// no longer depends on the horizon, so the run time grows about linearly
+// with the number of sections.
+//
+// cfg applies to every window, its history, on_best and repair are ignored;
+// every window sees the sections of cfg->eligible it covers. The whole
+// timetable is left in tt; stats may be NULL.
+int rolling_anneal(const Room *rooms, size_t num_rooms, size_t t, size_t n, size_t window, size_t overlap, Rng *rng,
+                   const AnnealConfig *cfg, Timetable *tt, RollingStats *stats)
+{
+    if (window == 0 || overlap >= window)
+        return 1;
+    double start_time = now_seconds();
+    size_t cap = 0;
+    for (size_t k = 0; k < num_rooms; k++)
+    {
+        if (rooms[k].cap > cap)
+            cap = rooms[k].cap;
+    }
+    if (timetable_init(tt, t, num_rooms, n, cap) != 0)
+    {
+        timetable_free(tt);
+        return 2;
+    }
+    size_t *history = (size_t *)calloc(n * num_rooms, sizeof(size_t));
+    if (history == NULL)
+    {
+        timetable_free(tt);
+        return 2;
+    }
+
+    AnnealConfig win_cfg = *cfg;
+    win_cfg.history = history;
+    win_cfg.on_best = NULL;
+    win_cfg.repair = NULL;
+    size_t windows = 0, steps = 0;
+    int ret = 0;
+    for (size_t start = 0; start < t && ret == 0;)
+    {
+        size_t end = start + window < t ? start + window : t;
+        size_t commit = end == t ? end : end - overlap;
+
+        Eligibility win_el;
+        if (cfg->eligible != NULL)
+        {
+            eligibility_window(&win_el, cfg->eligible, start, end - start);
+            win_cfg.eligible = &win_el;
+        }
+        Timetable win;
+        ret = solve_from(rooms, num_rooms, end - start, n, history, win_cfg.eligible, &win);
+        if (ret != 0)
+            break;
+        AnnealStats win_stats;
+        ret = simulated_annealing(&win, rooms, rng, &win_cfg, &win_stats);
+        windows++;
+        steps += win_stats.steps;
+
+        // fix the sections before the overlap and add their visits to the history
+        for (size_t i = 0; ret == 0 && i < commit - start; i++)
+        {
+            for (size_t k = 0; k < num_rooms; k++)
+            {
+                const int *staffs = room_staffs(&win, i, k);
+                for (size_t p = 0, sz = room_size(&win, i, k); p < sz; p++)
+                {
+                    assign(tt, start + i, k, staffs[p]);
+                    history[staffs[p] * num_rooms + k]++;
+                }
+            }
+        }
+        timetable_free(&win);
+        start = commit;
+    }
+
+    if (ret == 0 && stats != NULL)
+    {
+        stats->windows = windows;
+        stats->steps = steps;
+        stats->seconds = now_seconds() - start_time;
+        stats->energy = energy2(tt, rooms);
+        stats->lower_bound = energy2_lower_bound(tt, rooms, NULL, cfg->eligible);
+    }
+    free(history);
+    if (ret != 0)
+        timetable_free(tt);
+    return ret;
+}
+
+void tempering_default_config(TemperingConfig *cfg)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cfg->n_threads = cpus > 0 ? (size_t)cpus : 1;
+    cfg->n_replicas = cfg->n_threads < 8 ? 8 : cfg->n_threads;
+    cfg->t_min = 0.5;
+    cfg->t_max = 50;
+    cfg->sweep = 2000;
+    cfg->max_rounds = 400;
+    cfg->time_limit = 0;
+    cfg->seed = 1;
+    cfg->eligible = NULL;
+}
+
+// The state of replica i runs at temperature temps[i]. Exchanges swap whole
+// states between temperature slots.
+typedef struct Replica
+{
+    Timetable tt;
+    EnergyState st;
+    Rng rng;
+    Neighborhood nb;
+    Timetable best;
+    size_t best_e;
+    int err;
+} Replica;
+
+typedef struct TemperingWorker
+{
+    Replica *replicas;
+    const double *temps;
+    const Room *rooms;
+    size_t n_replicas;
+    size_t stride;
+    size_t first;
+    size_t sweep;
+} TemperingWorker;
+
+void *tempering_worker(void *arg)
+{
+    TemperingWorker *w = (TemperingWorker *)arg;
+    for (size_t i = w->first; i < w->n_replicas; i += w->stride)
+    {
+        Replica *rep = w->replicas + i;
+        for (size_t k = 0; k < w->sweep && rep->err == 0; k++)
+        {
+            if (anneal_step(&rep->tt, &rep->st, w->rooms, &rep->nb, &rep->rng, w->temps[i], &rep->err) && rep->st.total < rep->best_e)
+            {
+                rep->best_e = rep->st.total;
+                timetable_copy(&rep->best, &rep->tt);
+            }
+        }
+    }
+    return NULL;
+}
+
+double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void free_replicas(Replica *replicas, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        timetable_free(&replicas[i].tt);
+        timetable_free(&replicas[i].best);
+        energy_state_free(&replicas[i].st);
+    }
+    free(replicas);
+}
+
+// Run cfg->n_replicas annealers at fixed temperatures on cfg->n_threads
+// threads and exchange neighbouring states after every sweep. tt holds the
+// start state and receives the best state found by any replica. With no time
+// limit the result only depends on cfg->seed.
+int parallel_tempering(Timetable *tt, const Room *rooms, const TemperingConfig *cfg)
+{
+    size_t n = cfg->n_replicas;
+    size_t n_threads = cfg->n_threads < n ? cfg->n_threads : n;
+    if (n == 0 || n_threads == 0)
+        return 1;
+
+    Replica *replicas = (Replica *)calloc(n, sizeof(Replica));
+    double *temps = (double *)malloc(sizeof(double) * n);
+    pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * n_threads);
+    TemperingWorker *workers = (TemperingWorker *)malloc(sizeof(TemperingWorker) * n_threads);
+    if (replicas == NULL || temps == NULL || threads == NULL || workers == NULL)
+    {
+        free(replicas);
+        free(temps);
+        free(threads);
+        free(workers);
+        return 2;
+    }
+
+    int ret = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        Replica *rep = replicas + i;
+        if (timetable_init(&rep->tt, tt->n_secs, tt->n_rooms, tt->n_staffs, tt->cap) != 0 ||
+            timetable_init(&rep->best, tt->n_secs, tt->n_rooms, tt->n_staffs, tt->cap) != 0)
+        {
+            ret = 2;
+            break;
+        }
+        timetable_copy(&rep->tt, tt);
+        timetable_copy(&rep->best, tt);
+        if (energy_state_init(&rep->st, &rep->tt, rooms, NULL, cfg->eligible) != 0)
+        {
+            ret = 2;
+            break;
+        }
+        rep->best_e = rep->st.total;
+        rng_seed(&rep->rng, cfg->seed * n + i);
+        neighborhood_init(&rep->nb);
+        temps[i] = n == 1 ? cfg->t_min : cfg->t_min * pow(cfg->t_max / cfg->t_min, (double)i / (n - 1));
+    }
+
+    Rng rng;
+    rng_seed(&rng, ~cfg->seed);
+    double start = now_seconds();
+
+    for (size_t round = 0; ret == 0 && (cfg->max_rounds == 0 || round < cfg->max_rounds); round++)
+    {
+        if (cfg->time_limit > 0 && now_seconds() - start >= cfg->time_limit)
+            break;
+
+        for (size_t t = 0; t < n_threads; t++)
+        {
+            workers[t].replicas = replicas;
+            workers[t].temps = temps;
+            workers[t].rooms = rooms;
+            workers[t].n_replicas = n;
+            workers[t].stride = n_threads;
+            workers[t].first = t;
+            workers[t].sweep = cfg->sweep;
+        }
+        // the calling thread takes the first share
+        size_t spawned = 1;
+        for (; spawned < n_threads; spawned++)
+        {
+            if (pthread_create(&threads[spawned], NULL, tempering_worker, &workers[spawned]) != 0)
+                break;
+        }
+        tempering_worker(&workers[0]);
+        for (size_t t = 1; t < spawned; t++)
+        {
+            pthread_join(threads[t], NULL);
+        }
+        // replicas that got no thread run here so the round stays deterministic
+        for (size_t t = spawned; t < n_threads; t++)
+        {
+            tempering_worker(&workers[t]);
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            if (replicas[i].err != 0)
+                ret = replicas[i].err;
+        }
+
+        // alternate between even and odd neighbour pairs
+        for (size_t i = round % 2; i + 1 < n; i += 2)
+        {
+            double e_i = (double)replicas[i].st.total, e_j = (double)replicas[i + 1].st.total;
+            double p = exp((e_i - e_j) * (1 / temps[i] - 1 / temps[i + 1]));
+            if (p >= 1 || rng_double(&rng) < p)
+            {
+                Timetable tmp_tt = replicas[i].tt;
+                EnergyState tmp_st = replicas[i].st;
+                replicas[i].tt = replicas[i + 1].tt;
+                replicas[i].st = replicas[i + 1].st;
+                replicas[i + 1].tt = tmp_tt;
+                replicas[i + 1].st = tmp_st;
+            }
+        }
+    }
+
+    if (ret == 0)
+    {
+        size_t best = 0;
+        for (size_t i = 1; i < n; i++)
+        {
+            if (replicas[i].best_e < replicas[best].best_e)
+                best = i;
+        }
+        timetable_copy(tt, &replicas[best].best);
+    }
+
+    free_replicas(replicas, n);
+    free(temps);
+    free(threads);
+    free(workers);
+    return ret;
+}
@@ -0,0 +1,275 @@
+#ifndef ANNEAL_H
+#define ANNEAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "eligibility.h"
+#include "telemetry.h"
+
+#define NO_ASSIGN -1
+
+// xorshift64* stream, every annealer owns one so runs are reproducible and
+// can proceed on different threads
+typedef struct Rng
+{
+    uint64_t s;
+} Rng;
+
+typedef struct Room
+{
+    char *name;
+    int cap;
+} Room;
+
+// Assignment of every section stored in one block, laid out as
+// sections x rooms x cap. Room k of section i holds the staffs
+// slots[(i * n_rooms + k) * cap + p] for p < occupancy[i * n_rooms + k].
+// room_of[i * n_staffs + s] and slot_of[i * n_staffs + s] give the position
+// of staff s in section i, or NO_ASSIGN.
+typedef struct Timetable
+{
+    size_t n_secs;
+    size_t n_rooms;
+    size_t n_staffs;
+    size_t cap;
+    int *slots;
+    size_t *occupancy;
+    int *room_of;
+    int *slot_of;
+} Timetable;
+
+// A swap of staff l (in room a) and staff r (in room b) in section sec, or
+// when r is NO_ASSIGN the relocation of staff l from room a to room b.
+// Moves keep every staff in the sections it is seated in and only take it
+// to rooms it is qualified for.
+typedef struct Move
+{
+    size_t sec;
+    size_t a, b;
+    int l, r;
+} Move;
+
+#define MAX_MOVES 3
+
+typedef enum NeighborOp
+{
+    OP_SWAP,
+    OP_RELOCATE,
+    OP_CROSS,
+    OP_CHAIN,
+    N_OPS
+} NeighborOp;
+
+// Adaptive operator selection for neighbor(). Operators are drawn in
+// proportion to weight; score and uses collect the rewards of the current
+// segment, after which the weights are updated.
+typedef struct Neighborhood
+{
+    double weight[N_OPS];
+    double score[N_OPS];
+    size_t uses[N_OPS];
+    size_t steps;
+    NeighborOp last;
+} Neighborhood;
+
+// Incremental form of energy2. visits[s * n_rooms + k] counts the sections in
+// which staff s sits in room k, counting the history of earlier sections
+// when there is one, and sec_cost[i] caches the capacity term of
+// section i. Moves are applied to the state after they were made on the
+// timetable and reverted after they were undone.
+typedef struct EnergyState
+{
+    /// visits of sections before the timetable, included in visits, or NULL
+    const size_t *history;
+    /// where the moves may put every staff, or NULL
+    const Eligibility *eligible;
+    size_t *visits;
+    size_t *sec_cost;
+    size_t total;
+} EnergyState;
+
+// Running totals of the greedy constructor in solve(), so that weight_fn
+// scores a (staff, room) candidate in constant time. Rooms of equal
+// capacity form a class, cap_class[k] is the class of room k.
+// assigned[s * n_rooms + k] counts the sections that put staff s in room k
+// and class_count[s * n_rooms + c] those that put it in class c.
+// pair_total[s] counts the room mates staff s has had, acc[k] everyone ever
+// put in room k, and member_sum[k] the ids in room k of the current section.
+// All of it lives in arena, which also holds the constructor's scratch.
+typedef struct GreedyState
+{
+    Arena arena;
+    size_t n_rooms;
+    size_t n_staffs;
+    size_t n_classes;
+    size_t *cap_class;
+    int64_t *pair_total;
+    int *assigned;
+    int *class_count;
+    int *acc;
+    int64_t *member_sum;
+} GreedyState;
+
+typedef struct AnnealConfig
+{
+    /// acceptance probability of an average uphill move at the start temperature
+    double initial_accept;
+    /// the schedule is frozen once an increase of 1 is accepted with this probability
+    double final_accept;
+    /// moves sampled to calibrate the start temperature
+    size_t samples;
+    /// Metropolis steps between two temperature updates, 0 for sections x staffs
+    size_t epoch;
+    /// epochs without a new best before a reheat
+    size_t patience;
+    size_t max_reheats;
+    /// reheat temperature as a fraction of the start temperature
+    double reheat;
+    /// stop after this many steps, 0 for no limit
+    size_t max_steps;
+    /// stop after this many seconds, 0 for no limit; results then depend on timing
+    double time_limit;
+    /// stop once energy_gap() of the best energy to energy2_lower_bound() is at most this,
+    /// 0 stops only at the bound, where the best state is optimal
+    double gap_tolerance;
+    /// optional, the run stops soon after another thread sets *cancel
+    const volatile int *cancel;
+    /// optional, called with the timetable and its energy whenever the best energy improves
+    void (*on_best)(const Timetable *tt, size_t energy, void *user);
+    void *user;
+    /// optional visits of the sections before the timetable, n_staffs x n_rooms as in
+    /// EnergyState, so that the timetable is annealed as the continuation of a schedule
+    const size_t *history;
+    /// optional rooms and sections every staff may be scheduled in; the timetable must respect it
+    const Eligibility *eligible;
+    /// optional, receives the run's timing and counters, and its trajectory when built with SCHED_TELEMETRY
+    Telemetry *telemetry;
+    /// optional large move, e.g. anneal_lns(): it may rewrite the current state as long as
+    /// energy2 does not rise, and returns 0 or an error that ends the run
+    int (*repair)(Timetable *tt, const Room *rooms, void *user);
+    void *repair_user;
+    /// epochs between two repairs, at least 1
+    size_t repair_every;
+    /// candidate moves scored together in every step, 0 or 1 for one neighbor() move per step
+    size_t batch;
+    /// apply the best candidate of a batch under the Metropolis rule rather than the first it accepts
+    int batch_best;
+} AnnealConfig;
+
+typedef struct AnnealStats
+{
+    size_t steps;
+    /// candidate moves scored, steps times the batch size in batched runs
+    size_t evaluated;
+    size_t accepted;
+    size_t epochs;
+    size_t reheats;
+    /// calls of cfg->repair
+    size_t repairs;
+    double t0, t_final;
+    size_t best_energy;
+    /// energy2_lower_bound() of the timetable and its gap to best_energy
+    size_t lower_bound;
+    double gap;
+    double seconds;
+    /// the step or time limit, or a cancel, ended the run rather than convergence
+    int timed_out;
+    /// the gap fell to cfg->gap_tolerance and ended the run
+    int gap_closed;
+} AnnealStats;
+
+// Rolling-horizon annealing, see rolling_anneal().
+typedef struct RollingStats
+{
+    size_t windows;
+    size_t steps;
+    double seconds;
+    /// energy2 of the whole timetable and its energy2_lower_bound()
+    size_t energy;
+    size_t lower_bound;
+} RollingStats;
+
+typedef struct TemperingConfig
+{
+    size_t n_replicas;
+    size_t n_threads;
+    /// temperatures of the coldest and hottest replica, the others are spaced geometrically
+    double t_min, t_max;
+    /// Metropolis steps every replica takes between two exchange rounds
+    size_t sweep;
+    /// stop after this many rounds, 0 for no limit
+    size_t max_rounds;
+    /// stop after this many seconds, 0 for no limit; results then depend on timing
+    double time_limit;
+    uint64_t seed;
+    /// optional, as in AnnealConfig
+    const Eligibility *eligible;
+} TemperingConfig;
+
+void rng_seed(Rng *rng, uint64_t seed);
+uint64_t rng_next(Rng *rng);
+size_t rng_below(Rng *rng, size_t n);
+double rng_double(Rng *rng);
+Room *gen_rooms(size_t r, size_t n, Arena *arena);
+int min_int(int a, int b);
+void shuffle_int_arr(Rng *rng, int *arr, int n);
+int greedy_init(GreedyState *g, const Room *rooms, size_t num_rooms, size_t n);
+void greedy_free(GreedyState *g);
+void greedy_next_section(GreedyState *g);
+int64_t weight_fn(const GreedyState *g, int staff, size_t room_id, size_t room_size);
+void greedy_assign(GreedyState *g, const int *members, size_t room_size, size_t room_id, int staff);
+int timetable_init(Timetable *tt, size_t n_secs, size_t n_rooms, size_t n_staffs, size_t cap);
+void timetable_free(Timetable *tt);
+void timetable_copy(Timetable *dst, const Timetable *src);
+int *room_staffs(const Timetable *tt, size_t sec, size_t room);
+size_t room_size(const Timetable *tt, size_t sec, size_t room);
+void assign(Timetable *tt, size_t sec, size_t room, int staff);
+void clear_section(Timetable *tt, size_t sec);
+void swap_staffs(Timetable *tt, size_t sec, int l, int r);
+void relocate_staff(Timetable *tt, size_t sec, int staff, size_t to);
+void apply_move(Timetable *tt, const Move *m);
+int solve(const Room *rooms, size_t num_rooms, int t, int n, Timetable *tt);
+int solve_from(const Room *rooms, size_t num_rooms, int t, int n, const size_t *history, const Eligibility *eligible,
+               Timetable *tt);
+size_t energy(const Timetable *tt);
+size_t visit_energy(const Timetable *tt, const size_t *history);
+size_t section_cost(const Timetable *tt, const Room *rooms, size_t sec);
+size_t energy2(const Timetable *tt, const Room *rooms);
+size_t energy2_after(const Timetable *tt, const Room *rooms, const size_t *history);
+size_t visit_lower_bound(const Timetable *tt, const size_t *history, const Eligibility *eligible);
+size_t section_lower_bound(const Room *rooms, size_t n_rooms, size_t seated);
+size_t energy2_lower_bound(const Timetable *tt, const Room *rooms, const size_t *history, const Eligibility *eligible);
+double energy_gap(size_t energy, size_t bound);
+void undo_moves(Timetable *tt, const Move *moves, size_t moves_len);
+void neighborhood_init(Neighborhood *nb);
+void neighborhood_feedback(Neighborhood *nb, long long delta, int accepted);
+NeighborOp pick_op(const Neighborhood *nb, Rng *rng);
+int pick_hot(const Timetable *tt, const EnergyState *st, Rng *rng, size_t *sec, int *staff);
+int pick_target(const Timetable *tt, const EnergyState *st, Rng *rng, size_t sec, int s, int from);
+int pick_partner(const Timetable *tt, const EnergyState *st, Rng *rng, size_t sec, int b, int to);
+void chain_moves(Timetable *tt, const EnergyState *st, Rng *rng, size_t sec, int s, size_t len, Move *moves, size_t *moves_len);
+void cross_move(Timetable *tt, const EnergyState *st, Rng *rng, size_t sec, int s, Move *moves, size_t *moves_len);
+void relocate_move(Timetable *tt, const EnergyState *st, const Room *rooms, Rng *rng, Move *moves, size_t *moves_len);
+int neighbor(Timetable *tt, const EnergyState *st, const Room *rooms, Neighborhood *nb, Rng *rng, Move *moves, size_t *moves_len);
+int energy_state_init(EnergyState *st, const Timetable *tt, const Room *rooms, const size_t *history,
+                      const Eligibility *eligible);
+void energy_state_free(EnergyState *st);
+long long energy_state_visit(EnergyState *st, const Timetable *tt, int staff, size_t from, size_t to);
+long long energy_state_section(EnergyState *st, const Timetable *tt, const Room *rooms, size_t sec);
+long long energy_state_apply(EnergyState *st, const Timetable *tt, const Room *rooms, const Move *moves, size_t moves_len);
+void energy_state_revert(EnergyState *st, const Timetable *tt, const Room *rooms, const Move *moves, size_t moves_len);
+int anneal_step(Timetable *tt, EnergyState *st, const Room *rooms, Neighborhood *nb, Rng *rng, double temperature, int *err);
+void anneal_default_config(AnnealConfig *cfg);
+double calibrate_temperature(Timetable *tt, EnergyState *st, const Room *rooms, Neighborhood *nb, Rng *rng, const AnnealConfig *cfg, int *err);
+double cooling_factor(double acceptance);
+int anneal_should_stop(const AnnealConfig *cfg, double start);
+int simulated_annealing(Timetable *tt, const Room *rooms, Rng *rng, const AnnealConfig *cfg, AnnealStats *stats);
+int rolling_anneal(const Room *rooms, size_t num_rooms, size_t t, size_t n, size_t window, size_t overlap, Rng *rng,
+                   const AnnealConfig *cfg, Timetable *tt, RollingStats *stats);
+void tempering_default_config(TemperingConfig *cfg);
+double now_seconds();
+int parallel_tempering(Timetable *tt, const Room *rooms, const TemperingConfig *cfg);
+
+#endif
@@ -0,0 +1,109 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+// every block starts on a multiple of ARENA_ALIGN, enough for any scalar type
+#define ARENA_ALIGN 16
+
+// the payload of a chunk starts after its header, rounded up to ARENA_ALIGN
+size_t arena_header()
+{
+    return (sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+void arena_init(Arena *a, size_t chunk_size)
+{
+    a->head = NULL;
+    a->chunk_size = chunk_size != 0 ? chunk_size : ARENA_CHUNK;
+    a->allocated = 0;
+}
+
+void *arena_alloc(Arena *a, size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    ArenaChunk *c = a->head;
+    if (c == NULL || c->size - c->used < size)
+    {
+        size_t payload = size > a->chunk_size ? size : a->chunk_size;
+        ArenaChunk *fresh = (ArenaChunk *)malloc(arena_header() + payload);
+        if (fresh == NULL)
+            return NULL;
+        fresh->size = payload;
+        fresh->used = 0;
+        // an oversized chunk goes behind the current one, which may still have room
+        if (c != NULL && size > a->chunk_size)
+        {
+            fresh->next = c->next;
+            c->next = fresh;
+        }
+        else
+        {
+            fresh->next = c;
+            a->head = fresh;
+        }
+        c = fresh;
+    }
+    void *p = (char *)c + arena_header() + c->used;
+    c->used += size;
+    a->allocated += size;
+    return p;
+}
+
+void *arena_calloc(Arena *a, size_t n, size_t size)
+{
+    if (size != 0 && n > SIZE_MAX / size)
+        return NULL;
+    void *p = arena_alloc(a, n * size);
+    if (p != NULL)
+        memset(p, 0, n * size);
+    return p;
+}
+
+char *arena_strdup(Arena *a, const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *p = (char *)arena_alloc(a, len);
+    if (p != NULL)
+        memcpy(p, s, len);
+    return p;
+}
+
+// forget every block but keep the newest regular chunk for the next run
+void arena_reset(Arena *a)
+{
+    ArenaChunk *keep = NULL;
+    ArenaChunk *c = a->head;
+    while (c != NULL)
+    {
+        ArenaChunk *next = c->next;
+        if (keep == NULL && c->size == a->chunk_size)
+        {
+            keep = c;
+            keep->used = 0;
+        }
+        else
+        {
+            free(c);
+        }
+        c = next;
+    }
+    if (keep != NULL)
+        keep->next = NULL;
+    a->head = keep;
+    a->allocated = 0;
+}
+
+void arena_free(Arena *a)
+{
+    ArenaChunk *c = a->head;
+    while (c != NULL)
+    {
+        ArenaChunk *next = c->next;
+        free(c);
+        c = next;
+    }
+    a->head = NULL;
+    a->allocated = 0;
+}
@@ -0,0 +1,36 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator for memory that lives exactly as long as one solve. Blocks
+// are carved out of large chunks and never freed one by one; arena_free
+// releases all of them at once, so a long-running process neither leaks
+// the blocks of a run nor fragments its heap with them.
+
+typedef struct ArenaChunk
+{
+    struct ArenaChunk *next;
+    size_t size;
+    size_t used;
+} ArenaChunk;
+
+typedef struct Arena
+{
+    ArenaChunk *head;
+    /// payload of a regular chunk, larger requests get a chunk of their own
+    size_t chunk_size;
+    /// bytes handed out since the last reset
+    size_t allocated;
+} Arena;
+
+#define ARENA_CHUNK 65536
+
+void arena_init(Arena *a, size_t chunk_size);
+void *arena_alloc(Arena *a, size_t size);
+void *arena_calloc(Arena *a, size_t n, size_t size);
+char *arena_strdup(Arena *a, const char *s);
+void arena_reset(Arena *a);
+void arena_free(Arena *a);
+
+#endif
@@ -0,0 +1,315 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "batch.h"
+
+// Both forms are read straight from the mapped file. The text parser never
+// reads past br->size, since a mapping is not NUL-terminated.
+
+int batch_open(batch_reader *br, const char *path)
+{
+    memset(br, 0, sizeof(batch_reader));
+    br->line = 1;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 1;
+    struct stat sb;
+    if (fstat(fd, &sb) != 0)
+    {
+        close(fd);
+        return 1;
+    }
+    br->size = (size_t)sb.st_size;
+    if (br->size > 0)
+    {
+        void *data = mmap(NULL, br->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            return 1;
+        }
+        br->data = (const char *)data;
+        br->mapped = br->size;
+    }
+    close(fd);
+
+    if (br->size >= 8 && memcmp(br->data, BATCH_MAGIC, 4) == 0)
+    {
+        uint32_t count;
+        memcpy(&count, br->data + 4, sizeof(uint32_t));
+        br->binary = 1;
+        br->left = count;
+        br->pos = 8;
+    }
+    return 0;
+}
+
+void batch_close(batch_reader *br)
+{
+    if (br->mapped != 0)
+        munmap((void *)br->data, br->mapped);
+    free(br->bounds);
+    memset(br, 0, sizeof(batch_reader));
+}
+
+int batch_reserve(batch_reader *br, size_t rooms)
+{
+    if (2 * rooms <= br->bounds_cap)
+        return 0;
+    size_t *bounds = (size_t *)realloc(br->bounds, sizeof(size_t) * 2 * rooms);
+    if (bounds == NULL)
+        return 2;
+    br->bounds = bounds;
+    br->bounds_cap = 2 * rooms;
+    return 0;
+}
+
+// skip blanks and a trailing comment, but not the end of the line
+void batch_skip_blank(batch_reader *br)
+{
+    while (br->pos < br->size && (br->data[br->pos] == ' ' || br->data[br->pos] == '\t' || br->data[br->pos] == '\r'))
+    {
+        br->pos++;
+    }
+    if (br->pos < br->size && br->data[br->pos] == '#')
+    {
+        while (br->pos < br->size && br->data[br->pos] != '\n')
+        {
+            br->pos++;
+        }
+    }
+}
+
+int batch_number(batch_reader *br, size_t *v)
+{
+    batch_skip_blank(br);
+    size_t start = br->pos;
+    *v = 0;
+    while (br->pos < br->size && br->data[br->pos] >= '0' && br->data[br->pos] <= '9')
+    {
+        *v = *v * 10 + (size_t)(br->data[br->pos] - '0');
+        br->pos++;
+    }
+    return br->pos > start && br->pos - start < 10 ? 0 : 2;
+}
+
+int batch_next_text(batch_reader *br, scheduler_instance *inst)
+{
+    for (;;)
+    {
+        batch_skip_blank(br);
+        if (br->pos == br->size)
+            return 1;
+        if (br->data[br->pos] != '\n')
+            break;
+        br->pos++;
+        br->line++;
+    }
+
+    size_t rows, rooms, people, co;
+    if (batch_number(br, &rows) != 0 || batch_number(br, &rooms) != 0 || batch_number(br, &people) != 0 ||
+        batch_number(br, &co) != 0 || batch_reserve(br, rooms) != 0)
+        return 2;
+    for (size_t c = 0; c < rooms; c++)
+    {
+        if (batch_number(br, &br->bounds[c]) != 0)
+            return 2;
+        if (br->pos == br->size || br->data[br->pos] != ':')
+            return 2;
+        br->pos++;
+        if (batch_number(br, &br->bounds[rooms + c]) != 0)
+            return 2;
+    }
+    batch_skip_blank(br);
+    if (br->pos < br->size)
+    {
+        if (br->data[br->pos] != '\n')
+            return 2;
+        br->pos++;
+        br->line++;
+    }
+
+    inst->n_rows = rows;
+    inst->n_rooms = rooms;
+    inst->n_people = people;
+    inst->max_co_assign = (int)co;
+    inst->min_size = br->bounds;
+    inst->max_size = br->bounds + rooms;
+    return 0;
+}
+
+int batch_next_binary(batch_reader *br, scheduler_instance *inst)
+{
+    if (br->left == 0)
+        return 1;
+    uint32_t head[4];
+    if (br->size - br->pos < sizeof(head))
+        return 2;
+    memcpy(head, br->data + br->pos, sizeof(head));
+    br->pos += sizeof(head);
+    size_t rooms = head[1];
+    if ((br->size - br->pos) / (2 * sizeof(uint32_t)) < rooms || batch_reserve(br, rooms) != 0)
+        return 2;
+    for (size_t k = 0; k < 2 * rooms; k++)
+    {
+        uint32_t v;
+        memcpy(&v, br->data + br->pos, sizeof(uint32_t));
+        br->pos += sizeof(uint32_t);
+        br->bounds[k] = v;
+    }
+    br->left--;
+
+    inst->n_rows = head[0];
+    inst->n_rooms = rooms;
+    inst->n_people = head[2];
+    inst->max_co_assign = (int)head[3];
+    inst->min_size = br->bounds;
+    inst->max_size = br->bounds + rooms;
+    return 0;
+}
+
+/**
+   \brief Read the next instance into inst, return 1 at the end of the file and 2 on a malformed record.
+
+   The bounds of inst point into br and stay valid until the next call.
+*/
+int batch_next(batch_reader *br, scheduler_instance *inst)
+{
+    return br->binary ? batch_next_binary(br, inst) : batch_next_text(br, inst);
+}
+
+/**
+   \brief Read every remaining instance into *insts, with their bounds copied into *bounds.
+
+   Both arrays are malloc'ed and owned by the caller. Return 2 on a
+   malformed record or when memory runs out.
+*/
+int batch_load(batch_reader *br, scheduler_instance **insts, size_t **bounds, size_t *n)
+{
+    size_t cap = 0, len = 0, b_cap = 0, b_len = 0;
+    // where the bounds of every instance start, the bounds array may still move
+    size_t *offsets = NULL;
+    *insts = NULL;
+    *bounds = NULL;
+    *n = 0;
+    scheduler_instance inst;
+    int r;
+    while ((r = batch_next(br, &inst)) == 0)
+    {
+        if (len == cap)
+        {
+            cap = cap == 0 ? 256 : cap * 2;
+            scheduler_instance *grown = (scheduler_instance *)realloc(*insts, sizeof(scheduler_instance) * cap);
+            size_t *grown_offsets = (size_t *)realloc(offsets, sizeof(size_t) * cap);
+            if (grown != NULL)
+                *insts = grown;
+            if (grown_offsets != NULL)
+                offsets = grown_offsets;
+            if (grown == NULL || grown_offsets == NULL)
+            {
+                r = 2;
+                break;
+            }
+        }
+        while (b_len + 2 * inst.n_rooms > b_cap)
+        {
+            b_cap = b_cap == 0 ? 1024 : b_cap * 2;
+            size_t *grown = (size_t *)realloc(*bounds, sizeof(size_t) * b_cap);
+            if (grown == NULL)
+            {
+                free(offsets);
+                return 2;
+            }
+            *bounds = grown;
+        }
+        memcpy(*bounds + b_len, inst.min_size, sizeof(size_t) * 2 * inst.n_rooms);
+        offsets[len] = b_len;
+        (*insts)[len++] = inst;
+        b_len += 2 * inst.n_rooms;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        (*insts)[i].min_size = *bounds + offsets[i];
+        (*insts)[i].max_size = *bounds + offsets[i] + (*insts)[i].n_rooms;
+    }
+    free(offsets);
+    *n = len;
+    return r == 1 ? 0 : 2;
+}
+
+int batch_write_words(FILE *out, const uint32_t *words, size_t n)
+{
+    return fwrite(words, sizeof(uint32_t), n, out) == n ? 0 : 1;
+}
+
+// the count is left at 0 until batch_finish
+int batch_write_header(FILE *out)
+{
+    uint32_t count = 0;
+    if (fwrite(BATCH_MAGIC, 1, 4, out) != 4)
+        return 1;
+    return batch_write_words(out, &count, 1);
+}
+
+int batch_write_instance(FILE *out, const scheduler_instance *inst)
+{
+    uint32_t head[4] = {(uint32_t)inst->n_rows, (uint32_t)inst->n_rooms, (uint32_t)inst->n_people,
+                        (uint32_t)inst->max_co_assign};
+    if (batch_write_words(out, head, 4) != 0)
+        return 1;
+    for (size_t k = 0; k < 2 * inst->n_rooms; k++)
+    {
+        uint32_t v = (uint32_t)(k < inst->n_rooms ? inst->min_size[k] : inst->max_size[k - inst->n_rooms]);
+        if (batch_write_words(out, &v, 1) != 0)
+            return 1;
+    }
+    return 0;
+}
+
+// patch the record count into the header, out must be seekable
+int batch_finish(FILE *out, size_t count)
+{
+    uint32_t n = (uint32_t)count;
+    if (fseek(out, 4, SEEK_SET) != 0 || batch_write_words(out, &n, 1) != 0)
+        return 1;
+    return fseek(out, 0, SEEK_END);
+}
+
+/**
+   \brief Write the outcome of instance id as one JSON line, rooms[r][i] being the room of person i in row r.
+*/
+void batch_write_result(FILE *out, size_t id, int ret, const scheduler_solution *sol)
+{
+    const char *status = ret != 0                               ? "error"
+                         : sol->status == SCHEDULER_FEASIBLE  ? "feasible"
+                         : sol->status == SCHEDULER_HEURISTIC ? "heuristic"
+                         : sol->infeasible                    ? "infeasible"
+                                                              : "none";
+    fprintf(out, "{\"id\":%zu,\"status\":\"%s\",\"infeasible\":%d,\"seconds\":%.6f", id, status, sol->infeasible,
+            sol->seconds);
+    if (ret == 0 && sol->status != SCHEDULER_NONE)
+    {
+        fprintf(out, ",\"energy\":%zu,\"max_overlap\":%zu,\"co_violated\":%d,\"rooms\":[", sol->energy,
+                sol->max_overlap, sol->co_violated);
+        for (size_t r = 0; r < sol->n_rows; r++)
+        {
+            if (r > 0)
+                fputc(',', out);
+            fputc('[', out);
+            for (size_t i = 0; i < sol->n_people; i++)
+            {
+                fprintf(out, i == 0 ? "%d" : ",%d", sol->room_of[r * sol->n_people + i]);
+            }
+            fputc(']', out);
+        }
+        fputc(']', out);
+    }
+    fprintf(out, "}\n");
+    fflush(out);
+}
@@ -0,0 +1,53 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "scheduler.h"
+
+// Instance files hold many scheduler_instance records, in one of two forms.
+//
+// Text, one instance per line, '#' starts a comment:
+//
+//     <rows> <rooms> <people> <max_co_assign> <min>:<max> ... (one pair per room)
+//
+// Binary, meant to be memory-mapped: the header
+//
+//     char magic[4] = "SCB1", uint32_t count
+//
+// followed by count records of uint32_t words in host byte order:
+//
+//     rows, rooms, people, max_co_assign, min[rooms], max[rooms]
+//
+// batch_open detects the form from the magic.
+
+#define BATCH_MAGIC "SCB1"
+
+typedef struct _batch_reader_
+{
+    int binary;
+    const char *data;
+    size_t size;
+    size_t pos;
+    /// line of the text form that batch_next stopped at
+    size_t line;
+    /// records left in the binary form
+    size_t left;
+    /// bounds of the current instance, min in [0, rooms) and max after it
+    size_t *bounds;
+    size_t bounds_cap;
+    size_t mapped;
+} batch_reader;
+
+int batch_open(batch_reader *br, const char *path);
+int batch_next(batch_reader *br, scheduler_instance *inst);
+void batch_close(batch_reader *br);
+int batch_load(batch_reader *br, scheduler_instance **insts, size_t **bounds, size_t *n);
+int batch_write_header(FILE *out);
+int batch_write_instance(FILE *out, const scheduler_instance *inst);
+int batch_finish(FILE *out, size_t count);
+void batch_write_result(FILE *out, size_t id, int ret, const scheduler_solution *sol);
+
+#endif
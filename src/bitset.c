@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "bitset.h"
+
+// Popcount kernels with an AVX2 path, compiled in when the compiler targets
+// AVX2 (e.g. -mavx2 or the SCHED_AVX2 CMake option), and a scalar fallback.
+// The AVX2 path counts the bits of every byte with a nibble lookup table and
+// sums the bytes of each 64-bit lane with a SAD against zero.
+
+size_t popcount64(uint64_t x)
+{
+#if defined(__GNUC__)
+    return (size_t)__builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (size_t)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+#ifdef __AVX2__
+__m256i popcount256(__m256i v)
+{
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_and_si256(v, low);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+    __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo), _mm256_shuffle_epi8(lut, hi));
+    return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+
+size_t sum256(__m256i acc)
+{
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return (size_t)(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+}
+#endif
+
+size_t popcount_words(const uint64_t *a, size_t n)
+{
+    size_t w = 0, total = 0;
+#ifdef __AVX2__
+    __m256i acc = _mm256_setzero_si256();
+    for (; w + 4 <= n; w += 4)
+    {
+        acc = _mm256_add_epi64(acc, popcount256(_mm256_loadu_si256((const __m256i *)(a + w))));
+    }
+    total = sum256(acc);
+#endif
+    for (; w < n; w++)
+    {
+        total += popcount64(a[w]);
+    }
+    return total;
+}
+
+// popcount of a AND b, n words each
+size_t popcount_and(const uint64_t *a, const uint64_t *b, size_t n)
+{
+    size_t w = 0, total = 0;
+#ifdef __AVX2__
+    __m256i acc = _mm256_setzero_si256();
+    for (; w + 4 <= n; w += 4)
+    {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + w));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + w));
+        acc = _mm256_add_epi64(acc, popcount256(_mm256_and_si256(va, vb)));
+    }
+    total = sum256(acc);
+#endif
+    for (; w < n; w++)
+    {
+        total += popcount64(a[w] & b[w]);
+    }
+    return total;
+}
+
+// the bitsets of staff s, one per room, are contiguous
+uint64_t *visit_bits_of(const VisitBits *vb, int staff, size_t room)
+{
+    return vb->bits + ((size_t)staff * vb->n_rooms + room) * vb->words;
+}
+
+// build the bitsets of a schedule given as room_of[i * n_staffs + s], the
+// layout of Timetable.room_of; unassigned entries are skipped
+int visit_bits_init(VisitBits *vb, const int *room_of, size_t n_secs, size_t n_rooms, size_t n_staffs)
+{
+    vb->n_secs = n_secs;
+    vb->n_rooms = n_rooms;
+    vb->n_staffs = n_staffs;
+    vb->words = (n_secs + 63) / 64;
+    vb->bits = (uint64_t *)calloc(n_staffs * n_rooms * vb->words + 1, sizeof(uint64_t));
+    if (vb->bits == NULL)
+        return 2;
+    for (size_t i = 0; i < n_secs; i++)
+    {
+        for (size_t s = 0; s < n_staffs; s++)
+        {
+            int k = room_of[i * n_staffs + s];
+            if (k != NO_ASSIGN)
+                visit_bits_of(vb, s, k)[i / 64] |= (uint64_t)1 << (i % 64);
+        }
+    }
+    return 0;
+}
+
+int visit_bits_from(VisitBits *vb, const Timetable *tt)
+{
+    return visit_bits_init(vb, tt->room_of, tt->n_secs, tt->n_rooms, tt->n_staffs);
+}
+
+void visit_bits_free(VisitBits *vb)
+{
+    free(vb->bits);
+    vb->bits = NULL;
+}
+
+size_t visit_bits_count(const VisitBits *vb, int staff, size_t room)
+{
+    return popcount_words(visit_bits_of(vb, staff, room), vb->words);
+}
+
+// sections in which staffs a and b share a room
+size_t visit_bits_overlap(const VisitBits *vb, int a, int b)
+{
+    return popcount_and(visit_bits_of(vb, a, 0), visit_bits_of(vb, b, 0), vb->n_rooms * vb->words);
+}
+
+// the visit term of energy(), the sum of all squared visit counts
+size_t visit_bits_energy(const VisitBits *vb)
+{
+    size_t acc = 0;
+    for (size_t s = 0; s < vb->n_staffs; s++)
+    {
+        for (size_t k = 0; k < vb->n_rooms; k++)
+        {
+            size_t v = visit_bits_count(vb, s, k);
+            acc += v * v;
+        }
+    }
+    return acc;
+}
+
+// the largest overlap of any two staffs, one such pair goes to *a and *b when they are not NULL
+size_t visit_bits_max_overlap(const VisitBits *vb, int *a, int *b)
+{
+    size_t best = 0;
+    if (a != NULL)
+        *a = NO_ASSIGN;
+    if (b != NULL)
+        *b = NO_ASSIGN;
+    for (size_t i = 0; i < vb->n_staffs; i++)
+    {
+        for (size_t j = i + 1; j < vb->n_staffs; j++)
+        {
+            size_t v = visit_bits_overlap(vb, i, j);
+            if (v > best || (a != NULL && *a == NO_ASSIGN))
+            {
+                best = v;
+                if (a != NULL)
+                    *a = (int)i;
+                if (b != NULL)
+                    *b = (int)j;
+            }
+        }
+    }
+    return best;
+}
+
+// the pairs of staffs that share a room in more than max_co_assign sections
+size_t visit_bits_co_violations(const VisitBits *vb, size_t max_co_assign)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < vb->n_staffs; i++)
+    {
+        for (size_t j = i + 1; j < vb->n_staffs; j++)
+        {
+            if (visit_bits_overlap(vb, i, j) > max_co_assign)
+                count++;
+        }
+    }
+    return count;
+}
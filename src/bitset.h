@@ -0,0 +1,36 @@
+#ifndef BITSET_H
+#define BITSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "anneal.h"
+
+// Room visits of every staff as bitsets over sections. Bit i of
+// bits[(s * n_rooms + k) * words ...] is set when staff s sits in room k in
+// section i, so a visit count is a popcount and the sections two staffs
+// share are the popcount of the AND of their bitsets, summed over rooms.
+// This takes n_staffs x n_rooms x n_secs bits, where a pair count matrix
+// takes n_staffs^2 ints.
+typedef struct VisitBits
+{
+    size_t n_secs;
+    size_t n_rooms;
+    size_t n_staffs;
+    /// 64-bit words per bitset
+    size_t words;
+    uint64_t *bits;
+} VisitBits;
+
+size_t popcount_words(const uint64_t *a, size_t n);
+size_t popcount_and(const uint64_t *a, const uint64_t *b, size_t n);
+int visit_bits_init(VisitBits *vb, const int *room_of, size_t n_secs, size_t n_rooms, size_t n_staffs);
+int visit_bits_from(VisitBits *vb, const Timetable *tt);
+void visit_bits_free(VisitBits *vb);
+size_t visit_bits_count(const VisitBits *vb, int staff, size_t room);
+size_t visit_bits_overlap(const VisitBits *vb, int a, int b);
+size_t visit_bits_energy(const VisitBits *vb);
+size_t visit_bits_max_overlap(const VisitBits *vb, int *a, int *b);
+size_t visit_bits_co_violations(const VisitBits *vb, size_t max_co_assign);
+
+#endif
@@ -0,0 +1,248 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "eligibility.h"
+
+// Both models only create what an eligible assignment needs: the greedy
+// constructor and the annealer's moves never put a staff where it may not
+// sit, and the Z3 encoders make no variable for such a cell (see
+// schedule.c), so the pairwise terms of assert_co_assign shrink with them.
+
+// everyone available everywhere and qualified for every room, the bits are allocated from arena
+int eligibility_init(Eligibility *el, size_t n_staffs, size_t n_secs, size_t n_rooms, Arena *arena)
+{
+    el->n_staffs = n_staffs;
+    el->n_secs = n_secs;
+    el->n_rooms = n_rooms;
+    el->first = 0;
+    el->sec_words = (n_secs + 63) / 64;
+    el->room_words = (n_rooms + 63) / 64;
+    el->secs = (uint64_t *)arena_calloc(arena, n_staffs * (el->sec_words + el->room_words) + 1, sizeof(uint64_t));
+    if (el->secs == NULL)
+    {
+        el->rooms = NULL;
+        return 2;
+    }
+    el->rooms = el->secs + n_staffs * el->sec_words;
+    for (size_t s = 0; s < n_staffs; s++)
+    {
+        for (size_t i = 0; i < n_secs; i++)
+        {
+            eligibility_set_section(el, (int)s, i, 1);
+        }
+        for (size_t k = 0; k < n_rooms; k++)
+        {
+            eligibility_set_room(el, (int)s, k, 1);
+        }
+    }
+    return 0;
+}
+
+// sections [first, first + n_secs) of el as a view that shares its bits
+void eligibility_window(Eligibility *view, const Eligibility *el, size_t first, size_t n_secs)
+{
+    *view = *el;
+    view->first = el->first + first;
+    view->n_secs = n_secs;
+}
+
+void eligibility_set_section(Eligibility *el, int staff, size_t sec, int on)
+{
+    size_t bit = el->first + sec;
+    uint64_t *w = el->secs + staff * el->sec_words + bit / 64;
+    if (on)
+        *w |= 1ULL << (bit % 64);
+    else
+        *w &= ~(1ULL << (bit % 64));
+}
+
+void eligibility_set_room(Eligibility *el, int staff, size_t room, int on)
+{
+    uint64_t *w = el->rooms + staff * el->room_words + room / 64;
+    if (on)
+        *w |= 1ULL << (room % 64);
+    else
+        *w &= ~(1ULL << (room % 64));
+}
+
+int eligible_section(const Eligibility *el, int staff, size_t sec)
+{
+    if (el == NULL)
+        return 1;
+    size_t bit = el->first + sec;
+    return (el->secs[staff * el->sec_words + bit / 64] >> (bit % 64)) & 1;
+}
+
+int eligible_room(const Eligibility *el, int staff, size_t room)
+{
+    if (el == NULL)
+        return 1;
+    return (el->rooms[staff * el->room_words + room / 64] >> (room % 64)) & 1;
+}
+
+int eligible(const Eligibility *el, int staff, size_t sec, size_t room)
+{
+    return eligible_section(el, staff, sec) && eligible_room(el, staff, room);
+}
+
+// rooms staff is qualified for, el must not be NULL
+size_t eligible_rooms(const Eligibility *el, int staff)
+{
+    return popcount_words(el->rooms + staff * el->room_words, el->room_words);
+}
+
+// staff may sit in every room of every section
+int eligibility_unrestricted(const Eligibility *el, int staff)
+{
+    if (el == NULL)
+        return 1;
+    if (eligible_rooms(el, staff) != el->n_rooms)
+        return 0;
+    for (size_t i = 0; i < el->n_secs; i++)
+    {
+        if (!eligible_section(el, staff, i))
+            return 0;
+    }
+    return 1;
+}
+
+// staffs a and b may sit in the same places, so exchanging them maps a schedule to another one
+int eligibility_same_staff(const Eligibility *el, int a, int b)
+{
+    if (el == NULL)
+        return 1;
+    if (memcmp(el->rooms + a * el->room_words, el->rooms + b * el->room_words, sizeof(uint64_t) * el->room_words) != 0)
+        return 0;
+    for (size_t i = 0; i < el->n_secs; i++)
+    {
+        if (eligible_section(el, a, i) != eligible_section(el, b, i))
+            return 0;
+    }
+    return 1;
+}
+
+// every staff is available in both sections a and b or in neither
+int eligibility_same_section(const Eligibility *el, size_t a, size_t b)
+{
+    if (el == NULL)
+        return 1;
+    for (size_t s = 0; s < el->n_staffs; s++)
+    {
+        if (eligible_section(el, (int)s, a) != eligible_section(el, (int)s, b))
+            return 0;
+    }
+    return 1;
+}
+
+// every staff is qualified for both rooms a and b or for neither
+int eligibility_same_room(const Eligibility *el, size_t a, size_t b)
+{
+    if (el == NULL)
+        return 1;
+    for (size_t s = 0; s < el->n_staffs; s++)
+    {
+        if (eligible_room(el, (int)s, a) != eligible_room(el, (int)s, b))
+            return 0;
+    }
+    return 1;
+}
+
+// Parse a list such as "0-3 5,7" or "*" from p to end into the values below n
+// and call set for each; return 2 when it is malformed or out of range.
+int eligibility_parse_list(Eligibility *el, int staff, const char *p, const char *end, size_t n,
+                           void (*set)(Eligibility *, int, size_t, int))
+{
+    for (size_t v = 0; v < n; v++)
+    {
+        set(el, staff, v, 0);
+    }
+    while (p < end)
+    {
+        if (*p == ' ' || *p == '\t' || *p == ',' || *p == '\r' || *p == '\n')
+        {
+            p++;
+            continue;
+        }
+        size_t lo, hi;
+        if (*p == '*')
+        {
+            p++;
+            if (n == 0)
+                continue;
+            lo = 0;
+            hi = n - 1;
+        }
+        else
+        {
+            char *next;
+            lo = hi = strtoul(p, &next, 10);
+            if (next == p)
+                return 2;
+            p = next;
+            if (p < end && *p == '-')
+            {
+                hi = strtoul(++p, &next, 10);
+                if (next == p)
+                    return 2;
+                p = next;
+            }
+        }
+        if (lo > hi || hi >= n)
+            return 2;
+        for (size_t v = lo; v <= hi; v++)
+        {
+            set(el, staff, v, 1);
+        }
+    }
+    return 0;
+}
+
+/**
+   \brief Restrict el, made by eligibility_init, by the lines of the file at path.
+
+   A line "s: sections | rooms" makes staff s available in the listed
+   sections and qualified for the listed rooms, e.g. "4: 0-2 5 | *". Staffs
+   without a line keep everything; # starts a comment. Return 1 when the
+   file cannot be read and 2 on a malformed line.
+*/
+int eligibility_load(Eligibility *el, const char *path)
+{
+    FILE *in = fopen(path, "r");
+    if (in == NULL)
+        return 1;
+    char *line = NULL;
+    size_t line_cap = 0;
+    int ret = 0;
+    while (ret == 0 && getline(&line, &line_cap, in) != -1)
+    {
+        char *end = strchr(line, '#');
+        if (end == NULL)
+            end = line + strlen(line);
+        char *p = line;
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        {
+            p++;
+        }
+        if (p == end)
+            continue;
+        char *next;
+        size_t s = strtoul(p, &next, 10);
+        char *colon = memchr(next, ':', end - next);
+        char *bar = colon == NULL ? NULL : memchr(colon, '|', end - colon);
+        if (next == p || bar == NULL || s >= el->n_staffs)
+        {
+            ret = 2;
+            break;
+        }
+        ret = eligibility_parse_list(el, (int)s, colon + 1, bar, el->n_secs, eligibility_set_section);
+        if (ret == 0)
+            ret = eligibility_parse_list(el, (int)s, bar + 1, end, el->n_rooms, eligibility_set_room);
+    }
+    free(line);
+    fclose(in);
+    return ret;
+}
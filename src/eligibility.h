@@ -0,0 +1,45 @@
+#ifndef ELIGIBILITY_H
+#define ELIGIBILITY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+// Where every staff may be scheduled, as two bitsets per staff. Bit
+// first + i of secs[s * sec_words ...] is set when staff s is available in
+// section i, and bit k of rooms[s * room_words ...] when it is qualified for
+// room k. Staff s may sit in room k of section i when both are set, so the
+// mask takes n_staffs x (n_secs + n_rooms) bits where a dense one takes
+// n_staffs x n_secs x n_rooms. A NULL Eligibility allows everything.
+//
+// The Z3 model calls staffs people, sections rows and rooms cols.
+typedef struct Eligibility
+{
+    size_t n_staffs;
+    size_t n_secs;
+    size_t n_rooms;
+    /// bit of section 0, not 0 in a view made by eligibility_window
+    size_t first;
+    /// 64-bit words per bitset
+    size_t sec_words;
+    size_t room_words;
+    uint64_t *secs;
+    uint64_t *rooms;
+} Eligibility;
+
+int eligibility_init(Eligibility *el, size_t n_staffs, size_t n_secs, size_t n_rooms, Arena *arena);
+void eligibility_window(Eligibility *view, const Eligibility *el, size_t first, size_t n_secs);
+void eligibility_set_section(Eligibility *el, int staff, size_t sec, int on);
+void eligibility_set_room(Eligibility *el, int staff, size_t room, int on);
+int eligible_section(const Eligibility *el, int staff, size_t sec);
+int eligible_room(const Eligibility *el, int staff, size_t room);
+int eligible(const Eligibility *el, int staff, size_t sec, size_t room);
+size_t eligible_rooms(const Eligibility *el, int staff);
+int eligibility_unrestricted(const Eligibility *el, int staff);
+int eligibility_same_staff(const Eligibility *el, int a, int b);
+int eligibility_same_section(const Eligibility *el, size_t a, size_t b);
+int eligibility_same_room(const Eligibility *el, size_t a, size_t b);
+int eligibility_load(Eligibility *el, const char *path);
+
+#endif
@@ -0,0 +1,203 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "executor.h"
+
+// Work-stealing executor for independent instances. Every worker owns a
+// deque of instance ids, dealt round robin, and takes them from the front,
+// so ids are started roughly in order. A worker whose deque is empty steals
+// from the back of the others'. Every solve makes its own Z3 context and
+// annealer RNG, so the workers share nothing but the deques and the output.
+//
+// Results wait in their slot until all lower ids have been delivered; the
+// worker that completes the lowest pending id delivers the run of finished
+// results behind it.
+
+typedef struct _executor_deque_
+{
+    pthread_mutex_t lock;
+    size_t *ids;
+    size_t head, tail;
+} executor_deque;
+
+typedef struct _executor_slot_
+{
+    scheduler_solution sol;
+    int ret;
+    int done;
+} executor_slot;
+
+typedef struct _executor_state_
+{
+    const executor_config *cfg;
+    const scheduler_instance *insts;
+    size_t n;
+    executor_deque *deques;
+    size_t n_deques;
+    executor_slot *slots;
+    pthread_mutex_t out_lock;
+    size_t next_out;
+} executor_state;
+
+typedef struct _executor_worker_
+{
+    executor_state *state;
+    size_t id;
+} executor_worker;
+
+void executor_default_config(executor_config *cfg)
+{
+    cfg->n_threads = 0;
+    cfg->timeout = 0;
+    scheduler_default_options(&cfg->base);
+    cfg->deliver = NULL;
+    cfg->user = NULL;
+}
+
+int executor_pop(executor_deque *d, int front, size_t *id)
+{
+    pthread_mutex_lock(&d->lock);
+    int found = d->head < d->tail;
+    if (found)
+        *id = front ? d->ids[d->head++] : d->ids[--d->tail];
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+// the next instance for worker w, from its own deque or stolen from another
+int executor_take(executor_state *st, size_t w, size_t *id)
+{
+    if (executor_pop(st->deques + w, 1, id))
+        return 1;
+    for (size_t k = 1; k < st->n_deques; k++)
+    {
+        if (executor_pop(st->deques + (w + k) % st->n_deques, 0, id))
+            return 1;
+    }
+    return 0;
+}
+
+void executor_complete(executor_state *st, size_t id)
+{
+    pthread_mutex_lock(&st->out_lock);
+    st->slots[id].done = 1;
+    while (st->next_out < st->n && st->slots[st->next_out].done)
+    {
+        executor_slot *slot = st->slots + st->next_out;
+        if (st->cfg->deliver != NULL)
+            st->cfg->deliver(st->next_out, slot->ret, &slot->sol, st->cfg->user);
+        scheduler_solution_free(&slot->sol);
+        st->next_out++;
+    }
+    pthread_mutex_unlock(&st->out_lock);
+}
+
+void *executor_worker_main(void *arg)
+{
+    executor_worker *w = (executor_worker *)arg;
+    executor_state *st = w->state;
+    size_t id;
+    while (executor_take(st, w->id, &id))
+    {
+        scheduler_options opts = st->cfg->base;
+        opts.seed = st->cfg->base.seed + id;
+        opts.deadline = st->cfg->timeout > 0 ? scheduler_now() + st->cfg->timeout : 0;
+        executor_slot *slot = st->slots + id;
+        slot->ret = scheduler_solve(st->insts + id, &opts, &slot->sol);
+        executor_complete(st, id);
+    }
+    return NULL;
+}
+
+/**
+   \brief Solve the n instances on cfg->n_threads workers and deliver every result in order.
+
+   Return 2 when the executor cannot be set up; the outcome of each
+   instance goes to cfg->deliver.
+*/
+int executor_run(const executor_config *cfg, const scheduler_instance *insts, size_t n)
+{
+    size_t n_threads = cfg->n_threads;
+    if (n_threads == 0)
+    {
+        long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = n_cpus > 0 ? (size_t)n_cpus : 1;
+    }
+    if (n_threads > n)
+        n_threads = n;
+    if (n == 0)
+        return 0;
+
+    executor_state st;
+    st.cfg = cfg;
+    st.insts = insts;
+    st.n = n;
+    st.n_deques = n_threads;
+    st.next_out = 0;
+    st.deques = (executor_deque *)calloc(n_threads, sizeof(executor_deque));
+    st.slots = (executor_slot *)calloc(n, sizeof(executor_slot));
+    size_t *ids = (size_t *)malloc(sizeof(size_t) * n);
+    pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * n_threads);
+    executor_worker *workers = (executor_worker *)malloc(sizeof(executor_worker) * n_threads);
+    if (st.deques == NULL || st.slots == NULL || ids == NULL || threads == NULL || workers == NULL)
+    {
+        free(st.deques);
+        free(st.slots);
+        free(ids);
+        free(threads);
+        free(workers);
+        return 2;
+    }
+
+    // deal the ids round robin, deque w holds w, w + n_threads, ...
+    size_t pos = 0;
+    for (size_t w = 0; w < n_threads; w++)
+    {
+        executor_deque *d = st.deques + w;
+        pthread_mutex_init(&d->lock, NULL);
+        d->ids = ids + pos;
+        d->head = 0;
+        d->tail = 0;
+        for (size_t id = w; id < n; id += n_threads)
+        {
+            d->ids[d->tail++] = id;
+        }
+        pos += d->tail;
+    }
+    pthread_mutex_init(&st.out_lock, NULL);
+
+    // the calling thread is worker 0
+    size_t spawned = 1;
+    for (size_t w = 0; w < n_threads; w++)
+    {
+        workers[w].state = &st;
+        workers[w].id = w;
+    }
+    for (; spawned < n_threads; spawned++)
+    {
+        if (pthread_create(threads + spawned, NULL, executor_worker_main, workers + spawned) != 0)
+            break;
+    }
+    // deques of workers that failed to start are stolen from by the others
+    executor_worker_main(workers);
+    for (size_t w = 1; w < spawned; w++)
+    {
+        pthread_join(threads[w], NULL);
+    }
+
+    for (size_t w = 0; w < n_threads; w++)
+    {
+        pthread_mutex_destroy(&st.deques[w].lock);
+    }
+    pthread_mutex_destroy(&st.out_lock);
+    free(st.deques);
+    free(st.slots);
+    free(ids);
+    free(threads);
+    free(workers);
+    return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <stddef.h>
+
+#include "scheduler.h"
+
+/// Receives the outcome of instance id; calls are serialised and come in id order.
+typedef void (*executor_deliver)(size_t id, int ret, const scheduler_solution *sol, void *user);
+
+typedef struct _executor_config_
+{
+    /// worker threads, 0 for one per online CPU
+    size_t n_threads;
+    /// seconds every instance may take from the moment a worker picks it up, 0 for no limit
+    double timeout;
+    /// options of every solve; the deadline is set per instance and the seed is offset by the instance id
+    scheduler_options base;
+    executor_deliver deliver;
+    void *user;
+} executor_config;
+
+void executor_default_config(executor_config *cfg);
+int executor_run(const executor_config *cfg, const scheduler_instance *insts, size_t n);
+
+#endif
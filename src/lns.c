@@ -0,0 +1,393 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <z3.h>
+
+#include "schedule.h"
+
+// Large-neighbourhood search: Z3 as a repair operator of the annealer. A
+// repair frees `window` consecutive sections of the current timetable, or
+// only n_free staffs in them, keeps everything else fixed and lets Z3's
+// optimiser find the best way to seat the freed staffs again. The result
+// replaces the window when it lowers the energy, which makes it a move that
+// random swaps would rarely find.
+//
+// Every room keeps its size in the freed sections, so the capacity term of
+// energy2 does not change and only the visit term is optimised. It is convex
+// in the visits, so it is the sum of unary steps: steps[j] of (s, k) holds
+// when staff s sits in room k more than j times in the window and adds the
+// increase of the square, 2 * (outside + j) + 1, to the objective.
+//
+// The cells, the one-room-per-section constraints and the steps are built
+// once, with no cell for a room its staff is not qualified for. A repair
+// asserts the room sizes, the fixed staffs, the objective and a bound that
+// asks for a better seating than the current one in a push/pop scope of the
+// same optimiser. When the optimiser times out, the best seating it found so
+// far is still used.
+
+void lns_default_config(lns_config *cfg)
+{
+    cfg->window = 2;
+    cfg->n_free = 4;
+    cfg->timeout_ms = 1000;
+    cfg->seed = 1;
+}
+
+size_t lns_cell(const lns_repair *lr, size_t r, size_t s, size_t k)
+{
+    return (r * lr->n_staffs + s) * lr->n_rooms + k;
+}
+
+/**
+   \brief Build the repair model for timetables of tt's shape, history and eligible as in AnnealConfig.
+*/
+int lns_init(lns_repair *lr, const Timetable *tt, const size_t *history, const Eligibility *eligible,
+             const lns_config *cfg)
+{
+    lr->cfg = *cfg;
+    if (lr->cfg.window == 0 || lr->cfg.window > tt->n_secs)
+        lr->cfg.window = tt->n_secs;
+    lr->n_secs = tt->n_secs;
+    lr->n_rooms = tt->n_rooms;
+    lr->n_staffs = tt->n_staffs;
+    lr->history = history;
+    lr->eligible = eligible;
+    memset(&lr->stats, 0, sizeof(lns_stats));
+    rng_seed(&lr->rng, cfg->seed);
+
+    schedule_scope_open(&lr->sc);
+    Z3_context ctx = lr->sc.ctx;
+    lr->opt = Z3_mk_optimize(ctx);
+    Z3_optimize_inc_ref(ctx, lr->opt);
+    if (lr->cfg.timeout_ms > 0)
+    {
+        Z3_params params = Z3_mk_params(ctx);
+        Z3_params_inc_ref(ctx, params);
+        Z3_params_set_uint(ctx, params, Z3_mk_string_symbol(ctx, "timeout"), lr->cfg.timeout_ms);
+        Z3_optimize_set_params(ctx, lr->opt, params);
+        Z3_params_dec_ref(ctx, params);
+    }
+
+    size_t w = lr->cfg.window, n = lr->n_staffs, len = lr->n_rooms;
+    size_t width = n > w ? n : w;
+    Arena *arena = &lr->sc.arena;
+    lr->cells = (Z3_ast *)arena_alloc(arena, sizeof(Z3_ast) * w * n * len);
+    lr->steps = (Z3_ast *)arena_alloc(arena, sizeof(Z3_ast) * n * len * w);
+    lr->outside = (size_t *)arena_alloc(arena, sizeof(size_t) * n * len);
+    lr->order = (int *)arena_alloc(arena, sizeof(int) * n);
+    lr->scratch = (Z3_ast *)arena_alloc(arena, sizeof(Z3_ast) * width);
+    lr->coeffs = (int *)arena_alloc(arena, sizeof(int) * width);
+    if (lr->cells == NULL || lr->steps == NULL || lr->outside == NULL || lr->order == NULL || lr->scratch == NULL ||
+        lr->coeffs == NULL)
+    {
+        lns_free(lr);
+        return 2;
+    }
+
+    Z3_sort bool_sort = Z3_mk_bool_sort(ctx);
+    Z3_ast no = Z3_mk_false(ctx);
+    char name[64];
+    for (size_t r = 0; r < w; r++)
+    {
+        for (size_t s = 0; s < n; s++)
+        {
+            for (size_t k = 0; k < len; k++)
+            {
+                sprintf(name, "l_%zu_%zu_%zu", r, s, k);
+                lr->cells[lns_cell(lr, r, s, k)] =
+                    eligible_room(eligible, (int)s, k) ? mk_var(ctx, name, bool_sort) : no;
+            }
+            Z3_optimize_assert(ctx, lr->opt, Z3_mk_atmost(ctx, len, lr->cells + lns_cell(lr, r, s, 0), 1));
+        }
+    }
+    for (size_t s = 0; s < n; s++)
+    {
+        for (size_t k = 0; k < len; k++)
+        {
+            for (size_t r = 0; r < w; r++)
+            {
+                lr->scratch[r] = lr->cells[lns_cell(lr, r, s, k)];
+            }
+            for (size_t j = 0; j < w; j++)
+            {
+                lr->steps[(s * len + k) * w + j] =
+                    eligible_room(eligible, (int)s, k) ? Z3_mk_atleast(ctx, w, lr->scratch, j + 1) : no;
+            }
+        }
+    }
+    return 0;
+}
+
+void lns_free(lns_repair *lr)
+{
+    Z3_optimize_dec_ref(lr->sc.ctx, lr->opt);
+    schedule_scope_close(&lr->sc);
+}
+
+// visits of every staff outside sections [start, start + window), with the history
+void lns_count_outside(lns_repair *lr, const Timetable *tt, size_t start)
+{
+    size_t len = lr->n_rooms;
+    if (lr->history != NULL)
+        memcpy(lr->outside, lr->history, sizeof(size_t) * lr->n_staffs * len);
+    else
+        memset(lr->outside, 0, sizeof(size_t) * lr->n_staffs * len);
+    for (size_t i = 0; i < tt->n_secs; i++)
+    {
+        if (i >= start && i < start + lr->cfg.window)
+            continue;
+        for (size_t s = 0; s < tt->n_staffs; s++)
+        {
+            int k = tt->room_of[i * tt->n_staffs + s];
+            if (k != NO_ASSIGN)
+                lr->outside[s * len + k]++;
+        }
+    }
+}
+
+// visit term of staff s given its rooms in the window, room[r] for section start + r
+size_t lns_staff_cost(const lns_repair *lr, size_t s, const int *room, size_t stride)
+{
+    size_t acc = 0;
+    for (size_t k = 0; k < lr->n_rooms; k++)
+    {
+        size_t v = lr->outside[s * lr->n_rooms + k];
+        for (size_t r = 0; r < lr->cfg.window; r++)
+        {
+            if (room[r * stride] == (int)k)
+                v++;
+        }
+        acc += v * v;
+    }
+    return acc;
+}
+
+/**
+   \brief Read the rooms of the window from model into seat, row major.
+
+   Return 0 unless they seat the same staffs in rooms of the same sizes as
+   tt and leave the staffs after the first n_free of lr->order in place,
+   which the model of a timed out check need not do.
+*/
+int lns_read_seats(const lns_repair *lr, Z3_model model, const Timetable *tt, size_t start, size_t n_free, int *seat)
+{
+    Z3_context ctx = lr->sc.ctx;
+    size_t n = lr->n_staffs, len = lr->n_rooms;
+    const int *room_of = tt->room_of + start * n;
+    for (size_t r = 0; r < lr->cfg.window; r++)
+    {
+        for (size_t s = 0; s < n; s++)
+        {
+            seat[r * n + s] = NO_ASSIGN;
+        }
+        for (size_t k = 0; k < len; k++)
+        {
+            size_t size = 0;
+            for (size_t s = 0; s < n; s++)
+            {
+                Z3_ast out;
+                if (!Z3_model_eval(ctx, model, lr->cells[lns_cell(lr, r, s, k)], true, &out))
+                    return 0;
+                if (Z3_get_bool_value(ctx, out) != Z3_L_TRUE)
+                    continue;
+                if (seat[r * n + s] != NO_ASSIGN)
+                    return 0;
+                seat[r * n + s] = (int)k;
+                size++;
+            }
+            if (size != room_size(tt, start + r, k))
+                return 0;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t s = lr->order[i];
+            if ((seat[r * n + s] == NO_ASSIGN) != (room_of[r * n + s] == NO_ASSIGN) ||
+                (i >= n_free && seat[r * n + s] != room_of[r * n + s]))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+   \brief Free a random window of tt and seat it again optimally, for AnnealConfig.repair with an lns_repair as user.
+
+   tt is only changed when its energy drops. A repair that times out or
+   finds nothing better is not an error; Z3 errors go to the context's
+   error handler, so only running out of memory returns non-zero.
+*/
+int lns_repair_step(Timetable *tt, const Room *rooms, void *user)
+{
+    (void)rooms;
+    lns_repair *lr = (lns_repair *)user;
+    Z3_context ctx = lr->sc.ctx;
+    Z3_optimize opt = lr->opt;
+    size_t w = lr->cfg.window, n = lr->n_staffs, len = lr->n_rooms;
+    double started = now_seconds();
+    size_t start = rng_below(&lr->rng, tt->n_secs - w + 1);
+    const int *room_of = tt->room_of + start * n;
+
+    // the first n_free staffs of a random order are freed
+    size_t n_free = lr->cfg.n_free == 0 || lr->cfg.n_free > n ? n : lr->cfg.n_free;
+    for (size_t s = 0; s < n; s++)
+    {
+        lr->order[s] = (int)s;
+    }
+    for (size_t i = 0; i < n_free; i++)
+    {
+        size_t j = i + rng_below(&lr->rng, n - i);
+        int tmp = lr->order[i];
+        lr->order[i] = lr->order[j];
+        lr->order[j] = tmp;
+    }
+    lns_count_outside(lr, tt, start);
+
+    Z3_optimize_push(ctx, opt);
+    for (size_t s = 0; s < n; s++)
+    {
+        lr->coeffs[s] = 1;
+    }
+    for (size_t r = 0; r < w; r++)
+    {
+        for (size_t k = 0; k < len; k++)
+        {
+            for (size_t s = 0; s < n; s++)
+            {
+                lr->scratch[s] = lr->cells[lns_cell(lr, r, s, k)];
+            }
+            Z3_optimize_assert(ctx, opt, Z3_mk_pbeq(ctx, n, lr->scratch, lr->coeffs, (int)room_size(tt, start + r, k)));
+        }
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t s = lr->order[i];
+        for (size_t r = 0; r < w; r++)
+        {
+            int k = room_of[r * n + s];
+            const Z3_ast *row = lr->cells + lns_cell(lr, r, s, 0);
+            if (k == NO_ASSIGN)
+                Z3_optimize_assert(ctx, opt, Z3_mk_atmost(ctx, len, row, 0));
+            else if (i >= n_free)
+                Z3_optimize_assert(ctx, opt, row[k]);
+            else
+                Z3_optimize_assert(ctx, opt, Z3_mk_or(ctx, len, row));
+        }
+    }
+    Z3_sort int_sort = Z3_mk_int_sort(ctx);
+    Z3_ast zero = Z3_mk_int(ctx, 0, int_sort);
+    Z3_ast *terms = (Z3_ast *)malloc(sizeof(Z3_ast) * n_free * len * w);
+    int *seat = (int *)malloc(sizeof(int) * w * n);
+    if (terms == NULL || seat == NULL)
+    {
+        free(terms);
+        free(seat);
+        Z3_optimize_pop(ctx, opt);
+        return 2;
+    }
+    size_t n_terms = 0, before = 0;
+    for (size_t i = 0; i < n_free; i++)
+    {
+        size_t s = lr->order[i];
+        before += lns_staff_cost(lr, s, room_of + s, n);
+        for (size_t k = 0; k < len; k++)
+        {
+            if (!eligible_room(lr->eligible, (int)s, k))
+                continue;
+            const Z3_ast *step = lr->steps + (s * len + k) * w;
+            for (size_t j = 0; j < w; j++)
+            {
+                Z3_ast weight = Z3_mk_int(ctx, (int)(2 * (lr->outside[s * len + k] + j) + 1), int_sort);
+                terms[n_terms++] = Z3_mk_ite(ctx, step[j], weight, zero);
+            }
+        }
+    }
+    // the objective leaves out the visits outside the window, sum of outside^2
+    size_t fixed = 0;
+    for (size_t i = 0; i < n_free; i++)
+    {
+        for (size_t k = 0; k < len; k++)
+        {
+            size_t v = lr->outside[lr->order[i] * len + k];
+            fixed += v * v;
+        }
+    }
+    Z3_ast cost = Z3_mk_add(ctx, n_terms, terms);
+    // only seatings better than the current one are of interest
+    Z3_optimize_assert(ctx, opt, Z3_mk_lt(ctx, cost, Z3_mk_int(ctx, (int)(before - fixed), int_sort)));
+    Z3_optimize_minimize(ctx, opt, cost);
+    free(terms);
+
+    Z3_lbool res = Z3_optimize_check(ctx, opt, 0, NULL);
+    Z3_model model = NULL;
+    if (res == Z3_L_TRUE)
+        model = Z3_optimize_get_model(ctx, opt);
+    else if (res == Z3_L_UNDEF)
+    {
+        // an optimisation that timed out may still have found a better seating
+        Z3_set_error_handler(ctx, nothrow_z3_error);
+        model = Z3_optimize_get_model(ctx, opt);
+        if (Z3_get_error_code(ctx) != Z3_OK)
+            model = NULL;
+        Z3_set_error_handler(ctx, error_handler);
+    }
+    if (model != NULL)
+    {
+        Z3_model_inc_ref(ctx, model);
+        int valid = lns_read_seats(lr, model, tt, start, n_free, seat);
+        Z3_model_dec_ref(ctx, model);
+
+        // the model of a timed out check is scored again, it need not satisfy the bound
+        size_t after = 0;
+        for (size_t i = 0; valid && i < n_free; i++)
+        {
+            after += lns_staff_cost(lr, lr->order[i], seat + lr->order[i], n);
+        }
+        if (valid && after < before)
+        {
+            for (size_t r = 0; r < w; r++)
+            {
+                clear_section(tt, start + r);
+                for (size_t s = 0; s < n; s++)
+                {
+                    if (seat[r * n + s] != NO_ASSIGN)
+                        assign(tt, start + r, seat[r * n + s], (int)s);
+                }
+            }
+            lr->stats.improved++;
+            lr->stats.gain += before - after;
+        }
+    }
+    free(seat);
+    Z3_optimize_pop(ctx, opt);
+
+    lr->stats.repairs++;
+    lr->stats.seconds += now_seconds() - started;
+    return 0;
+}
+
+/**
+   \brief simulated_annealing() with an lns_repair_step every cfg->repair_every epochs.
+
+   stats and out may be NULL.
+*/
+int anneal_lns(Timetable *tt, const Room *rooms, Rng *rng, const AnnealConfig *cfg, const lns_config *lns, AnnealStats *stats,
+               lns_stats *out)
+{
+    lns_repair lr;
+    if (lns_init(&lr, tt, cfg->history, cfg->eligible, lns) != 0)
+        return 2;
+    AnnealConfig lns_cfg = *cfg;
+    lns_cfg.repair = lns_repair_step;
+    lns_cfg.repair_user = &lr;
+    int ret = simulated_annealing(tt, rooms, rng, &lns_cfg, stats);
+    if (cfg->telemetry != NULL)
+    {
+        telemetry_stat(cfg->telemetry, "lns_repairs", (double)lr.stats.repairs);
+        telemetry_stat(cfg->telemetry, "lns_improved", (double)lr.stats.improved);
+        telemetry_stat(cfg->telemetry, "lns_seconds", lr.stats.seconds);
+    }
+    if (out != NULL)
+        *out = lr.stats;
+    lns_free(&lr);
+    return ret;
+}
@@ -1,444 +1,361 @@
-// some codes are copied from https://github.com/Z3Prover/z3/blob/master/examples/c/test_capi.c
-
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdarg.h>
-#include <memory.h>
-#include <setjmp.h>
+#include <string.h>
+#include <time.h>
 #include <z3.h>
 
-// #define LOG_Z3_CALLS
-
-#ifdef LOG_Z3_CALLS
-#define LOG_MSG(msg) Z3_append_log(msg)
-#else
-#define LOG_MSG(msg) ((void)0)
-#endif
-
-/**
-   \defgroup capi_ex C API examples
-*/
-/**@{*/
-/**
-   @name Auxiliary Functions
-*/
-/**@{*/
-
-/**
-   \brief exit gracefully in case of error.
-*/
-void exitf(const char *message)
-{
-    fprintf(stderr, "BUG: %s.\n", message);
-    exit(1);
-}
-
-/**
-   \brief exit if unreachable code was reached.
-*/
-void unreachable()
-{
-    exitf("unreachable code was reached");
-}
-
-/**
-   \brief Simpler error handler.
- */
-void error_handler(Z3_context c, Z3_error_code e)
-{
-    printf("Error code: %d\n", e);
-    printf("Detail: %s\n", Z3_get_error_msg(c, e));
-    exitf("incorrect use of Z3");
-}
-
-static jmp_buf g_catch_buffer;
-/**
-   \brief Low tech exceptions.
-
-   In high-level programming languages, an error handler can throw an exception.
-*/
-void throw_z3_error(Z3_context c, Z3_error_code e)
-{
-    longjmp(g_catch_buffer, e);
-}
-
-/**
-   \brief Error handling that depends on checking an error code on the context.
-
-*/
-
-void nothrow_z3_error(Z3_context c, Z3_error_code e)
-{
-    // no-op
-}
-
-/**
-   \brief Create a logical context.
-
-   Enable model construction. Other configuration parameters can be passed in the cfg variable.
-
-   Also enable tracing to stderr and register custom error handler.
-*/
-Z3_context mk_context_custom(Z3_config cfg, Z3_error_handler err)
-{
-    Z3_context ctx;
-
-    Z3_set_param_value(cfg, "model", "true");
-    ctx = Z3_mk_context(cfg);
-    Z3_set_error_handler(ctx, err);
-
-    return ctx;
-}
-
-Z3_solver mk_solver(Z3_context ctx)
-{
-    Z3_solver s = Z3_mk_solver(ctx);
-    Z3_solver_inc_ref(ctx, s);
-    return s;
-}
-
-void del_solver(Z3_context ctx, Z3_solver s)
+#include "schedule.h"
+
+// usage: sched [-pb] [-sym] [-n rooms] [-hy | -min | -pf workers | -rh window overlap | -lns window [free] | -se]
+//              [-co max_co_assign] [-el eligibility] [-T telemetry]
+// -pb selects the pseudo-Boolean encoding instead of nested Int arrays
+// -sym adds symmetry-breaking constraints
+// -n sets the number of rows and rooms, with 3n + 1 people (default 5)
+// -hy seeds the solver with a schedule from the annealer
+// -pf races differently configured solvers on that many threads (0: one per CPU)
+// -min searches for the smallest feasible max_co_assign, -co is ignored
+// -rh solves window rows at a time and compares with the monolithic solve
+// -lns anneals the rooms with Z3 repairs of window rows (of `free` people,
+//      default everyone) and compares with the annealer alone
+// -se solves in a schedule_session, then makes each kind of edit (the last
+//     person leaves, both bounds of room 0 drop by one, a row is added) and
+//     re-solves after each, printing the time and the cells that changed;
+//     -pb, -sym and -el are ignored
+// -el reads the rows and rooms every person may be assigned to, see
+//     eligibility_load(); -n still sets the shape
+// -T writes the phase timings and Z3 statistics to a .json or .csv file
+
+// write the telemetry of stats to path, when there is one
+void write_telemetry(const char *path, const schedule_stats *stats)
 {
-    Z3_solver_dec_ref(ctx, s);
+    if (path == NULL)
+        return;
+    Telemetry tel;
+    telemetry_init(&tel, 0);
+    if (schedule_stats_telemetry(stats, &tel) != 0 || telemetry_write(&tel, path) != 0)
+        fprintf(stderr, "cannot write %s\n", path);
+    telemetry_free(&tel);
 }
 
-/**
-   \brief Create a logical context.
-
-   Enable model construction only.
-
-   Also enable tracing to stderr and register standard error handler.
-*/
-Z3_context mk_context()
+// cells set in exactly one of a and b, over their first rows rows
+size_t changed_cells(const schedule_result *a, const schedule_result *b, size_t rows, size_t n_people, size_t cols)
 {
-    Z3_config cfg;
-    Z3_context ctx;
-    cfg = Z3_mk_config();
-    ctx = mk_context_custom(cfg, error_handler);
-    Z3_del_config(cfg);
-    return ctx;
-}
-
-/**
-   \brief Create a logical context.
-
-   Enable fine-grained proof construction.
-   Enable model construction.
-
-   Also enable tracing to stderr and register standard error handler.
-*/
-Z3_context mk_proof_context()
-{
-    Z3_config cfg = Z3_mk_config();
-    Z3_context ctx;
-    Z3_set_param_value(cfg, "proof", "true");
-    ctx = mk_context_custom(cfg, throw_z3_error);
-    Z3_del_config(cfg);
-    return ctx;
+    unsigned char *seen = (unsigned char *)calloc(rows * n_people * cols, 1);
+    if (seen == NULL)
+        return 0;
+    for (size_t k = 0; k < a->entry_cnt; k++)
+    {
+        const schedule_entry *e = a->entries + k;
+        if (e->row < rows)
+            seen[(e->row * n_people + e->person) * cols + e->col] |= 1;
+    }
+    for (size_t k = 0; k < b->entry_cnt; k++)
+    {
+        const schedule_entry *e = b->entries + k;
+        if (e->row < rows)
+            seen[(e->row * n_people + e->person) * cols + e->col] |= 2;
+    }
+    size_t changed = 0;
+    for (size_t k = 0; k < rows * n_people * cols; k++)
+    {
+        changed += seen[k] == 1 || seen[k] == 2;
+    }
+    free(seen);
+    return changed;
 }
 
-/**
-   \brief Create a variable using the given name and type.
-*/
-Z3_ast mk_var(Z3_context ctx, const char *name, Z3_sort ty)
+// Solve input in a session, then apply one edit of each kind and re-solve
+// after each, reporting how long it took and how much of the schedule moved.
+int session_demo(const schedule_input *input)
 {
-    Z3_symbol s = Z3_mk_string_symbol(ctx, name);
-    return Z3_mk_const(ctx, s, ty);
+    schedule_session s;
+    if (schedule_session_open(&s, input) != 0)
+    {
+        schedule_session_close(&s);
+        return 1;
+    }
+    const char *names[] = {"initial", "unavailable", "bounds", "add row"};
+    schedule_result prev, result;
+    size_t prev_row = 0;
+    int ret = 0;
+    for (int step = 0; step < 4 && ret == 0; step++)
+    {
+        double start = now_seconds();
+        if (step == 1)
+            schedule_session_set_available(&s, input->n_people - 1, 0);
+        else if (step == 2)
+            schedule_session_set_bounds(&s, 0, input->cols_x[0] > 0 ? input->cols_x[0] - 1 : 0,
+                                        input->cols_y[0] > 0 ? input->cols_y[0] - 1 : 0);
+        else if (step == 3 && schedule_session_add_row(&s) != 0)
+        {
+            ret = 1;
+            break;
+        }
+        ret = schedule_session_solve(&s, &result);
+        double seconds = now_seconds() - start;
+        const char *status = result.status == Z3_L_TRUE ? "sat" : result.status == Z3_L_FALSE ? "unsat" : "unknown";
+        if (ret == 0 && step == 0)
+            printf("%s: %s, %.3fs\n", names[step], status, seconds);
+        else if (ret == 0)
+            printf("%s: %s, %.3fs, %zu cells changed\n", names[step], status, seconds,
+                   result.status == Z3_L_TRUE && prev.status == Z3_L_TRUE
+                       ? changed_cells(&prev, &result, prev_row, s.n_people, s.cols_len)
+                       : 0);
+        if (step > 0)
+            free_schedule_result(&prev);
+        prev = result;
+        prev_row = s.row;
+    }
+    // a failed step still leaves its result in prev
+    free_schedule_result(&prev);
+    schedule_session_close(&s);
+    return ret;
 }
 
-typedef struct _schedule_input_
-{
-    size_t row;
-    /// (min, max) of human resource requirement for every room
-    size_t *cols_x, *cols_y;
-    size_t cols_len;
-    size_t n_people;
-    int max_co_assign;
-} schedule_input;
-
-typedef struct _schedule_entry_
+int main(int argc, char **argv)
 {
-    size_t row;
-    size_t col;
-    char *name;
-} schedule_entry;
-
-int schedule(const schedule_input input)
-{
-    Z3_context ctx = mk_context();
-    Z3_solver solver = mk_solver(ctx);
-    Z3_sort int_sort, array_sort, mat_sort, mat3_sort;
-    Z3_ast ms;
+#ifdef LOG_Z3_CALLS
+    Z3_open_log("z3.log");
+#endif
 
-    char **names = (char **)malloc(sizeof(char *) * input.n_people);
-    if (names == NULL)
-        return 1;
-    for (size_t i = 0; i < input.n_people; i++)
+    size_t size = 5;
+    for (int i = 1; i + 1 < argc; i++)
     {
-        names[i] = (char *)malloc(sizeof(char) * 24);
-        sprintf(names[i], "P%ld", i);
+        if (strcmp(argv[i], "-n") == 0)
+            size = strtoul(argv[i + 1], NULL, 10);
     }
-
-    int_sort = Z3_mk_int_sort(ctx);
-    array_sort = Z3_mk_array_sort(ctx, int_sort, int_sort);
-    mat_sort = Z3_mk_array_sort(ctx, int_sort, array_sort);
-    mat3_sort = Z3_mk_array_sort(ctx, int_sort, mat_sort);
-    ms = mk_var(ctx, "m", mat3_sort);
-
-    Z3_ast *int_row = (Z3_ast *)malloc(sizeof(Z3_ast) * sizeof(input.cols_len));
-    if (int_row == NULL)
-        return 1;
-    Z3_ast *int_col = (Z3_ast *)malloc(sizeof(Z3_ast) * sizeof(input.row));
-    if (int_col == NULL)
+    if (size == 0)
         return 1;
 
-    // for each people
-    for (size_t i = 0; i < input.n_people; i++)
+    schedule_input input;
+    input.row = size;
+    input.cols_len = size;
+    Arena arena;
+    arena_init(&arena, 0);
+    input.cols_x = (size_t *)arena_alloc(&arena, sizeof(size_t) * size);
+    input.cols_y = (size_t *)arena_alloc(&arena, sizeof(size_t) * size);
+    if (input.cols_x == NULL || input.cols_y == NULL)
     {
-        // m = ms[i]
-        Z3_ast m = Z3_mk_select(ctx, ms, Z3_mk_int64(ctx, i, int_sort));
-        for (size_t r = 0; r < input.row; r++)
+        arena_free(&arena);
+        return 1;
+    }
+    for (size_t i = 0; i < input.cols_len; i++)
+    {
+        input.cols_x[i] = 3;
+        input.cols_y[i] = 4;
+    }
+    input.n_people = 3 * size + 1;
+    input.max_co_assign = 3;
+    input.encoding = ENCODING_INT_ARRAY;
+    input.symmetry_breaking = 0;
+    input.timeout_ms = 0;
+    input.hint = NULL;
+    input.interrupt = NULL;
+    input.visited = NULL;
+    input.co_used = NULL;
+    input.rows_after = 0;
+    input.eligible = NULL;
+    int hybrid = 0, minimize = 0, session = 0;
+    int portfolio = -1;
+    size_t window = 0, overlap = 0;
+    lns_config lns;
+    lns_default_config(&lns);
+    lns.window = 0;
+    const char *telemetry_path = NULL, *eligibility_path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-pb") == 0)
+            input.encoding = ENCODING_PB;
+        else if (strcmp(argv[i], "-sym") == 0)
+            input.symmetry_breaking = 1;
+        else if (strcmp(argv[i], "-hy") == 0)
+            hybrid = 1;
+        else if (strcmp(argv[i], "-min") == 0)
+            minimize = 1;
+        else if (strcmp(argv[i], "-se") == 0)
+            session = 1;
+        else if (strcmp(argv[i], "-pf") == 0 && i + 1 < argc)
+            portfolio = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-co") == 0 && i + 1 < argc)
+            input.max_co_assign = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-rh") == 0 && i + 2 < argc)
         {
-            // row = m[r]
-            Z3_ast row = Z3_mk_select(ctx, m, Z3_mk_int64(ctx, r, int_sort));
-
-            for (size_t c = 0; c < input.cols_len; c++)
-            {
-                // int_row[c] = row[c]
-                int_row[c] = Z3_mk_select(ctx, row, Z3_mk_int64(ctx, c, int_sort));
-            }
-            // row_sum = sum(int_row)
-            Z3_ast row_sum = Z3_mk_add(ctx, input.cols_len, int_row);
-            // assert(row_sum == 1)
-            Z3_solver_assert(ctx, solver, Z3_mk_eq(ctx, row_sum, Z3_mk_int64(ctx, 1, int_sort)));
+            window = strtoul(argv[++i], NULL, 10);
+            overlap = strtoul(argv[++i], NULL, 10);
         }
-
-        for (size_t c = 0; c < input.cols_len; c++)
+        else if (strcmp(argv[i], "-lns") == 0 && i + 1 < argc)
         {
-            for (size_t r = 0; r < input.row; r++)
-            {
-                Z3_ast row = Z3_mk_select(ctx, m, Z3_mk_int64(ctx, r, int_sort));
-                int_col[r] = Z3_mk_select(ctx, row, Z3_mk_int64(ctx, c, int_sort));
-            }
-            Z3_ast col_sum = Z3_mk_add(ctx, input.row, int_col);
-            Z3_solver_assert(ctx, solver, Z3_mk_eq(ctx, col_sum, Z3_mk_int64(ctx, 1, int_sort)));
+            lns.window = strtoul(argv[++i], NULL, 10);
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                lns.n_free = strtoul(argv[++i], NULL, 10);
         }
-
-        for (size_t r = 0; r < input.row; r++)
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            i++;
+        else if (strcmp(argv[i], "-el") == 0 && i + 1 < argc)
+            eligibility_path = argv[++i];
+        else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc)
+            telemetry_path = argv[++i];
+    }
+    Eligibility el;
+    if (eligibility_path != NULL)
+    {
+        if (eligibility_init(&el, input.n_people, input.row, input.cols_len, &arena) != 0 ||
+            eligibility_load(&el, eligibility_path) != 0)
         {
-            Z3_ast row = Z3_mk_select(ctx, m, Z3_mk_int64(ctx, r, int_sort));
-            for (size_t c = 0; c < input.cols_len; c++)
-            {
-                Z3_ast v = Z3_mk_select(ctx, row, Z3_mk_int64(ctx, c, int_sort));
-                // assert(v >= 0)
-                Z3_solver_assert(ctx, solver, Z3_mk_ge(ctx, v, Z3_mk_int64(ctx, 0, int_sort)));
-            }
+            fprintf(stderr, "cannot read %s\n", eligibility_path);
+            arena_free(&arena);
+            return 1;
         }
+        input.eligible = &el;
     }
-
-    if (input.max_co_assign > 0)
+    if (session)
     {
-        Z3_ast *conds = (Z3_ast *)malloc(sizeof(Z3_ast) * (input.row * input.cols_len));
-        if (conds == NULL)
-            return 1;
-        int *coeffs = (int *)malloc(sizeof(int) * (input.row * input.cols_len));
-        if (coeffs == NULL)
+        int ret = session_demo(&input);
+        arena_free(&arena);
+        return ret;
+    }
+    if (lns.window > 0)
+    {
+        Room *rooms = input_rooms(&input, &arena);
+        Timetable tt, plain;
+        if (rooms == NULL ||
+            solve_from(rooms, input.cols_len, input.row, input.n_people, NULL, input.eligible, &tt) != 0)
+        {
+            arena_free(&arena);
             return 1;
-
-        for (size_t i = 0, n = input.row * input.cols_len; i < n; i++)
+        }
+        if (timetable_init(&plain, tt.n_secs, tt.n_rooms, tt.n_staffs, tt.cap) != 0)
         {
-            coeffs[i] = 1;
+            timetable_free(&tt);
+            arena_free(&arena);
+            return 1;
         }
-
-        for (size_t i = 0; i < input.n_people; i++)
+        timetable_copy(&plain, &tt);
+        Telemetry tel;
+        telemetry_init(&tel, 0);
+        AnnealConfig cfg;
+        anneal_default_config(&cfg);
+        cfg.eligible = input.eligible;
+        uint64_t seed = time(NULL);
+        lns.seed = seed;
+        Rng rng;
+        rng_seed(&rng, seed);
+        AnnealStats plain_stats, stats;
+        int ret = simulated_annealing(&plain, rooms, &rng, &cfg, &plain_stats);
+        if (telemetry_path != NULL)
+            cfg.telemetry = &tel;
+        rng_seed(&rng, seed);
+        lns_stats repairs;
+        if (ret == 0)
+            ret = anneal_lns(&tt, rooms, &rng, &cfg, &lns, &stats, &repairs);
+        if (ret == 0)
         {
-            Z3_ast ma = Z3_mk_select(ctx, ms, Z3_mk_int64(ctx, i, int_sort));
-            for (size_t j = i + 1; j < input.n_people; j++)
-            {
-                Z3_ast mb = Z3_mk_select(ctx, ms, Z3_mk_int64(ctx, j, int_sort));
-                Z3_ast *cond_it = conds;
-
-                for (size_t r = 0; r < input.row; r++)
-                {
-                    Z3_ast ma_row = Z3_mk_select(ctx, ma, Z3_mk_int64(ctx, r, int_sort));
-                    Z3_ast mb_row = Z3_mk_select(ctx, mb, Z3_mk_int64(ctx, r, int_sort));
-                    for (size_t c = 0; c < input.cols_len; c++)
-                    {
-                        Z3_ast l_gt_zero = Z3_mk_gt(
-                            ctx,
-                            // ma[r][c]
-                            Z3_mk_select(ctx, ma_row, Z3_mk_int64(ctx, c, int_sort)),
-                            // 0
-                            Z3_mk_int64(ctx, 0, int_sort));
-                        Z3_ast r_gt_zero = Z3_mk_gt(
-                            ctx,
-                            Z3_mk_select(ctx, mb_row, Z3_mk_int64(ctx, c, int_sort)),
-                            Z3_mk_int64(ctx, 0, int_sort));
-                        Z3_ast args[] = {l_gt_zero, r_gt_zero};
-                        *cond_it = Z3_mk_and(ctx, 2, args);
-                        cond_it++;
-                    }
-                }
-
-                Z3_solver_assert(
-                    ctx,
-                    solver,
-                    Z3_mk_pble(ctx, input.row * input.cols_len, conds, coeffs, input.max_co_assign));
-            }
+            printf("anneal: energy %zu (gap %.2f%%), %.3fs\n", plain_stats.best_energy, 100 * plain_stats.gap,
+                   plain_stats.seconds);
+            printf("lns: energy %zu (gap %.2f%%), %.3fs, %zu/%zu repairs improved by %zu in %.3fs\n",
+                   stats.best_energy, 100 * stats.gap, stats.seconds, repairs.improved, repairs.repairs, repairs.gain,
+                   repairs.seconds);
+            if (telemetry_path != NULL && telemetry_write(&tel, telemetry_path) != 0)
+                fprintf(stderr, "cannot write %s\n", telemetry_path);
         }
-
-        free(conds);
-        free(coeffs);
+        telemetry_free(&tel);
+        timetable_free(&plain);
+        timetable_free(&tt);
+        arena_free(&arena);
+        return ret;
     }
-
-    Z3_ast *assigns = (Z3_ast *)malloc(sizeof(Z3_ast) * input.n_people);
-    if (assigns == NULL)
-        return 1;
-
-    for (size_t r = 0; r < input.row; r++)
+    if (window > 0)
     {
-        for (size_t c = 0; c < input.cols_len; c++)
+        schedule_result result, mono;
+        schedule_stats stats, mono_stats;
+        double start = now_seconds();
+        int ret = schedule_rolling(input, window, overlap, &result, &stats);
+        double rolling_seconds = now_seconds() - start;
+        start = now_seconds();
+        if (ret == 0 && schedule_run(input, &mono, &mono_stats) == 0)
         {
-            for (size_t i = 0; i < input.n_people; i++)
-            {
-                Z3_ast m = Z3_mk_select(ctx, ms, Z3_mk_int64(ctx, i, int_sort));
-                Z3_ast row = Z3_mk_select(ctx, m, Z3_mk_int64(ctx, r, int_sort));
-                Z3_ast assign = Z3_mk_select(ctx, row, Z3_mk_int64(ctx, c, int_sort));
-                assigns[i] = assign;
-            }
-            Z3_ast assign_total = Z3_mk_add(ctx, input.n_people, assigns);
-
-            size_t x = input.cols_x[c];
-            size_t y = input.cols_y[c];
-            if (x == y)
-            {
-                Z3_solver_assert(ctx, solver, Z3_mk_eq(ctx, assign_total, Z3_mk_int64(ctx, x, int_sort)));
-            }
-            else
-            {
-                Z3_ast ge_mn = Z3_mk_ge(
-                    ctx,
-                    assign_total,
-                    Z3_mk_int64(ctx, x, int_sort));
-                Z3_ast le_mx = Z3_mk_le(
-                    ctx,
-                    assign_total,
-                    Z3_mk_int64(ctx, y, int_sort));
-                Z3_ast args[] = {ge_mn, le_mx};
-                Z3_solver_assert(
-                    ctx,
-                    solver,
-                    Z3_mk_and(ctx, 2, args));
-            }
+            double mono_seconds = now_seconds() - start;
+            print_schedule(&input, &result);
+            // the model has no objective, so quality is the closest pair in either schedule
+            printf("rolling: %s in %zu windows, %.3fs, max pair overlap %d\n",
+                   result.status == Z3_L_TRUE ? "sat" : result.status == Z3_L_FALSE ? "stuck" : "unknown",
+                   stats.windows, rolling_seconds, result.status == Z3_L_TRUE ? max_pair_overlap(&input, &result) : -1);
+            printf("monolithic: %s, %.3fs, max pair overlap %d\n",
+                   mono.status == Z3_L_TRUE ? "sat" : mono.status == Z3_L_FALSE ? "unsat" : "unknown", mono_seconds,
+                   mono.status == Z3_L_TRUE ? max_pair_overlap(&input, &mono) : -1);
+            write_telemetry(telemetry_path, &stats);
+        }
+        if (ret == 0)
+        {
+            free_schedule_result(&mono);
+            free_schedule_stats(&mono_stats);
         }
+        free_schedule_result(&result);
+        free_schedule_stats(&stats);
+        arena_free(&arena);
+        return ret;
     }
-
-    Z3_lbool res = Z3_solver_check(ctx, solver);
-    if (res != Z3_L_TRUE)
+    if (minimize)
     {
-        printf("unsat\n");
+        schedule_result result;
+        schedule_stats stats;
+        int best;
+        if (schedule_min_co_assign(input, &result, &best, &stats) == 0)
+        {
+            print_schedule(&input, &result);
+            if (best >= 0)
+                printf("max_co_assign %d after %zu checks, %.3fs\n", best, stats.co_probes, stats.check_seconds);
+            write_telemetry(telemetry_path, &stats);
+        }
+        free_schedule_result(&result);
+        free_schedule_stats(&stats);
+        arena_free(&arena);
+        return 0;
     }
-    else
+    if (portfolio >= 0)
     {
-        Z3_model model = Z3_solver_get_model(ctx, solver);
-        schedule_entry *entries = (schedule_entry *)malloc(sizeof(schedule_entry) * (input.row * input.cols_len * input.n_people));
-        if (entries == NULL)
-            return 1;
-        size_t entry_cnt = 0;
-        for (size_t i = 0; i < input.n_people; i++)
+        schedule_result result;
+        schedule_stats stats;
+        int winner;
+        if (schedule_portfolio(input, portfolio, &result, &winner, &stats) == 0)
         {
-            Z3_ast m = Z3_mk_select(ctx, ms, Z3_mk_int64(ctx, i, int_sort));
-            for (size_t r = 0; r < input.row; r++)
-            {
-                Z3_ast row = Z3_mk_select(ctx, m, Z3_mk_int64(ctx, r, int_sort));
-                for (size_t c = 0; c < input.cols_len; c++)
-                {
-                    Z3_ast assign = Z3_mk_select(ctx, row, Z3_mk_int64(ctx, c, int_sort));
-                    Z3_ast out;
-                    Z3_lbool success = Z3_model_eval(ctx, model, assign, true, &out);
-                    if (success != Z3_L_TRUE)
-                        return 2;
-                    int outi = -1;
-                    if (Z3_get_numeral_int(ctx, out, &outi))
-                    {
-                        if (outi > 0)
-                        {
-                            entries[entry_cnt].row = r;
-                            entries[entry_cnt].col = c;
-                            entries[entry_cnt].name = names[i];
-                            entry_cnt++;
-                        }
-                    }
-                    else
-                    {
-                        return 3;
-                    }
-                }
-            }
+            print_schedule(&input, &result);
+            if (winner >= 0)
+                printf("worker %d won, check %.3fs\n", winner, stats.check_seconds);
+            write_telemetry(telemetry_path, &stats);
         }
-
-        for (size_t r = 0; r < input.row; r++)
+        free_schedule_result(&result);
+        free_schedule_stats(&stats);
+        arena_free(&arena);
+        return 0;
+    }
+    if (!hybrid)
+    {
+        schedule_result result;
+        schedule_stats stats;
+        if (schedule_run(input, &result, &stats) == 0)
         {
-            for (size_t c = 0; c < input.cols_len; c++)
-            {
-                printf("[");
-                int first = 1;
-                for (size_t i = 0; i < entry_cnt; i++)
-                {
-                    if (entries[i].row == r && entries[i].col == c)
-                    {
-                        if (first)
-                        {
-                            first = 0;
-                        }
-                        else
-                        {
-                            printf(" ");
-                        }
-                        printf("%s", entries[i].name);
-                    }
-                }
-                printf("] ");
-            }
-            printf("\n");
+            print_schedule(&input, &result);
+            write_telemetry(telemetry_path, &stats);
         }
-
-        free(entries);
+        free_schedule_result(&result);
+        free_schedule_stats(&stats);
+        arena_free(&arena);
+        return 0;
     }
 
-    free(assigns);
-    free(int_row);
-    free(int_col);
-    free(names);
-    return 0;
-}
-
-int main()
-{
-#ifdef LOG_Z3_CALLS
-    Z3_open_log("z3.log");
-#endif
-
-    size_t xs[] = {3, 3, 3, 3, 3};
-    size_t ys[] = {4, 4, 4, 4, 4};
-
-    schedule_input input;
-    input.row = 5;
-    input.cols_len = 5;
-    input.cols_x = (size_t *)malloc(sizeof(size_t) * 5);
-    if (input.cols_x == NULL)
-        return 1;
-    input.cols_y = (size_t *)malloc(sizeof(size_t) * 5);
-    if (input.cols_y == NULL)
-        return 1;
-    for (size_t i = 0; i < input.cols_len; i++)
+    schedule_result result;
+    schedule_stats stats;
+    if (schedule_hybrid(input, time(NULL), &result, &stats) == 0)
     {
-        input.cols_x[i] = xs[i];
-        input.cols_y[i] = ys[i];
+        print_schedule(&input, &result);
+        printf("heuristic %.3fs, kept %zu/%zu hinted cells, check %.3fs\n", stats.hint_seconds,
+               stats.hints_kept, stats.hints_total, stats.check_seconds);
+        write_telemetry(telemetry_path, &stats);
     }
-    input.n_people = 16;
-    input.max_co_assign = 3;
-    schedule(input);
+    free_schedule_result(&result);
+    free_schedule_stats(&stats);
+    arena_free(&arena);
 
     return 0;
 }
@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <z3.h>
+
+#include "bitset.h"
+#include "schedule.h"
+
+// Search for the smallest max_co_assign that still has a schedule.
+//
+// The model is built once without a co-assignment bound. Every candidate
+// bound b gets its own literal guard[b], and the per-pair pble constraints
+// for b are only asserted as guard[b] -> pble(..., b), the first time b is
+// probed. A probe is a check under the single assumption guard[b], so all
+// probes run in one solver and share whatever it has learned. A bound that
+// is proven feasible is asserted for good, which only prunes later probes.
+
+/**
+   \brief Return the largest number of cells two people share in result.
+
+   Counted with the popcount kernels of bitset.c, which need n_people x
+   cols_len x row bits rather than a count for every pair.
+*/
+int max_pair_overlap(const schedule_input *input, const schedule_result *result)
+{
+    size_t n = input->n_people;
+    int *room_of = (int *)malloc(sizeof(int) * input->row * n);
+    if (room_of == NULL)
+        return -1;
+    for (size_t k = 0; k < input->row * n; k++)
+    {
+        room_of[k] = NO_ASSIGN;
+    }
+    for (size_t e = 0; e < result->entry_cnt; e++)
+    {
+        room_of[result->entries[e].row * n + result->entries[e].person] = (int)result->entries[e].col;
+    }
+
+    VisitBits vb;
+    int best = -1;
+    if (visit_bits_init(&vb, room_of, input->row, input->cols_len, n) == 0)
+        best = (int)visit_bits_max_overlap(&vb, NULL, NULL);
+    visit_bits_free(&vb);
+    free(room_of);
+    return best;
+}
+
+/**
+   \brief Find the smallest feasible max_co_assign for input and a schedule that meets it.
+
+   input.max_co_assign is ignored. On return *best holds the smallest bound
+   proven feasible, or -1 when the instance has no schedule at all. A probe
+   that times out stops the search, *best is then the tightest bound found so
+   far and may not be minimal. stats may be NULL.
+*/
+int schedule_min_co_assign(const schedule_input input, schedule_result *result, int *best, schedule_stats *stats)
+{
+    *best = -1;
+    if (stats != NULL)
+        memset(stats, 0, sizeof(schedule_stats));
+    if (init_schedule_result(result, input.n_people) != 0)
+        return 1;
+
+    double start = now_seconds();
+    schedule_scope sc;
+    schedule_scope_open(&sc);
+    sc.solver = mk_solver(sc.ctx);
+    Z3_context ctx = sc.ctx;
+    Z3_solver solver = sc.solver;
+    set_timeout(ctx, solver, input.timeout_ms);
+    int ret = 0;
+    Z3_ast *guards = NULL;
+    double built = 0, checked = 0;
+
+    Z3_ast *cells = build_model(&sc, input);
+    guards = (Z3_ast *)arena_calloc(&sc.arena, input.row + 1, sizeof(Z3_ast));
+    if (cells == NULL || guards == NULL)
+    {
+        ret = 1;
+        goto done;
+    }
+
+    built = now_seconds();
+    Z3_lbool res = Z3_solver_check(ctx, solver);
+    result->status = res;
+    if (stats != NULL)
+        stats->co_probes++;
+    if (res != Z3_L_TRUE)
+    {
+        checked = now_seconds();
+        goto done;
+    }
+    ret = extract_entries(ctx, Z3_solver_get_model(ctx, solver), &input, cells, result);
+    int hi = ret == 0 ? max_pair_overlap(&input, result) : -1;
+    if (hi < 0)
+    {
+        ret = 1;
+        goto done;
+    }
+
+    // hi is always feasible, every bound below lo is not
+    int lo = 0;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (guards[mid] == NULL)
+        {
+            char name[32];
+            sprintf(name, "co!%d", mid);
+            guards[mid] = mk_var(ctx, name, Z3_mk_bool_sort(ctx));
+            if (assert_co_assign(ctx, solver, input, cells, mid, guards[mid], &sc.arena) != 0)
+            {
+                ret = 1;
+                goto done;
+            }
+        }
+        res = Z3_solver_check_assumptions(ctx, solver, 1, &guards[mid]);
+        if (stats != NULL)
+            stats->co_probes++;
+        if (res == Z3_L_TRUE)
+        {
+            ret = extract_entries(ctx, Z3_solver_get_model(ctx, solver), &input, cells, result);
+            int overlap = ret == 0 ? max_pair_overlap(&input, result) : -1;
+            if (overlap < 0)
+            {
+                ret = 1;
+                goto done;
+            }
+            // the model may be tighter than the bound it was asked for
+            hi = overlap;
+            Z3_solver_assert(ctx, solver, guards[mid]);
+        }
+        else if (res == Z3_L_FALSE)
+        {
+            lo = mid + 1;
+            Z3_solver_assert(ctx, solver, Z3_mk_not(ctx, guards[mid]));
+        }
+        else
+        {
+            LOG_MSG("co-assignment search stopped: probe returned unknown");
+            break;
+        }
+    }
+    checked = now_seconds();
+    result->status = Z3_L_TRUE;
+    *best = hi;
+
+done:
+    if (stats != NULL && checked > 0)
+    {
+        stats->build_seconds = built - start;
+        stats->check_seconds = checked - built;
+        if (collect_stats(ctx, solver, stats) != 0)
+            ret = 1;
+    }
+    schedule_scope_close(&sc);
+    return ret;
+}
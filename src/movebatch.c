@@ -0,0 +1,179 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "movebatch.h"
+
+// The delta of candidate i is
+//
+//   2 * (l_to - l_from + 1) + [swap] 2 * (r_to - r_from + 1) + sec_delta
+//
+// the change of the squared visits of staff l leaving room a for b, of
+// staff r going the other way, and of the capacity term. The visit part is
+// computed on eight int32 lanes at a time when the compiler targets AVX2
+// (e.g. -mavx2 or the SCHED_AVX2 CMake option) and widened to int64 for the
+// capacity part; the scalar loop does the rest.
+
+int move_batch_init(MoveBatch *mb, size_t cap)
+{
+    mb->cap = cap;
+    mb->len = 0;
+    mb->moves = (Move *)malloc(sizeof(Move) * cap);
+    // the int32 lanes share one block, as do the int64 ones
+    mb->l_from = (int32_t *)malloc(sizeof(int32_t) * 5 * cap);
+    mb->sec_delta = (int64_t *)malloc(sizeof(int64_t) * 2 * cap);
+    if (mb->moves == NULL || mb->l_from == NULL || mb->sec_delta == NULL)
+    {
+        move_batch_free(mb);
+        return 2;
+    }
+    mb->l_to = mb->l_from + cap;
+    mb->r_from = mb->l_to + cap;
+    mb->r_to = mb->r_from + cap;
+    mb->swap = mb->r_to + cap;
+    mb->delta = mb->sec_delta + cap;
+    return 0;
+}
+
+void move_batch_free(MoveBatch *mb)
+{
+    free(mb->moves);
+    free(mb->l_from);
+    free(mb->sec_delta);
+    mb->moves = NULL;
+    mb->l_from = NULL;
+    mb->sec_delta = NULL;
+}
+
+// change of the capacity term of section sec if a staff moved from room a to room b
+long long relocate_section_delta(const Timetable *tt, const EnergyState *st, const Room *rooms, size_t sec, int a, int b)
+{
+    long long mn = 0, mx = 0;
+    for (size_t j = 0; j < tt->n_rooms; j++)
+    {
+        long long slack = (long long)rooms[j].cap - (long long)room_size(tt, sec, j);
+        if ((int)j == a)
+            slack++;
+        else if ((int)j == b)
+            slack--;
+        if (j == 0 || slack < mn)
+            mn = slack;
+        if (j == 0 || slack > mx)
+            mx = slack;
+    }
+    return mx * (mx - mn) - (long long)st->sec_cost[sec];
+}
+
+// Draw k candidates the way OP_SWAP does, a hot staff and a room it rarely
+// visits, turn every other one whose target room has space into a
+// relocation, and gather what their deltas need.
+void move_batch_fill(MoveBatch *mb, const Timetable *tt, const EnergyState *st, const Room *rooms, Rng *rng, size_t k)
+{
+    size_t n_rooms = tt->n_rooms;
+    mb->len = 0;
+    if (k > mb->cap)
+        k = mb->cap;
+    for (size_t i = 0; i < k; i++)
+    {
+        size_t sec;
+        int s;
+        if (pick_hot(tt, st, rng, &sec, &s) != 0)
+            continue;
+        int a = tt->room_of[sec * tt->n_staffs + s];
+        int b = pick_target(tt, st, rng, sec, s, a);
+        if (b == NO_ASSIGN)
+            continue;
+        int r = NO_ASSIGN;
+        if (!(i & 1) || room_size(tt, sec, b) >= (size_t)rooms[b].cap)
+        {
+            r = pick_partner(tt, st, rng, sec, b, a);
+            if (r == NO_ASSIGN)
+                continue;
+        }
+        size_t c = mb->len++;
+        Move *m = mb->moves + c;
+        m->sec = sec;
+        m->a = a;
+        m->b = b;
+        m->l = s;
+        m->r = r;
+        mb->l_from[c] = (int32_t)st->visits[s * n_rooms + a];
+        mb->l_to[c] = (int32_t)st->visits[s * n_rooms + b];
+        if (r == NO_ASSIGN)
+        {
+            mb->r_from[c] = mb->r_to[c] = 0;
+            mb->swap[c] = 0;
+            mb->sec_delta[c] = relocate_section_delta(tt, st, rooms, sec, a, b);
+        }
+        else
+        {
+            mb->r_from[c] = (int32_t)st->visits[r * n_rooms + b];
+            mb->r_to[c] = (int32_t)st->visits[r * n_rooms + a];
+            mb->swap[c] = -1;
+            mb->sec_delta[c] = 0;
+        }
+    }
+}
+
+// the energy delta of every candidate, see the top of the file
+void move_batch_deltas(MoveBatch *mb)
+{
+    size_t i = 0;
+#ifdef __AVX2__
+    const __m256i one = _mm256_set1_epi32(1);
+    for (; i + 8 <= mb->len; i += 8)
+    {
+        __m256i lf = _mm256_loadu_si256((const __m256i *)(mb->l_from + i));
+        __m256i lt = _mm256_loadu_si256((const __m256i *)(mb->l_to + i));
+        __m256i rf = _mm256_loadu_si256((const __m256i *)(mb->r_from + i));
+        __m256i rt = _mm256_loadu_si256((const __m256i *)(mb->r_to + i));
+        __m256i swap = _mm256_loadu_si256((const __m256i *)(mb->swap + i));
+        __m256i l = _mm256_add_epi32(_mm256_sub_epi32(lt, lf), one);
+        __m256i r = _mm256_and_si256(_mm256_add_epi32(_mm256_sub_epi32(rt, rf), one), swap);
+        __m256i d = _mm256_slli_epi32(_mm256_add_epi32(l, r), 1);
+        __m256i lo = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(d));
+        __m256i hi = _mm256_cvtepi32_epi64(_mm256_extracti128_si256(d, 1));
+        lo = _mm256_add_epi64(lo, _mm256_loadu_si256((const __m256i *)(mb->sec_delta + i)));
+        hi = _mm256_add_epi64(hi, _mm256_loadu_si256((const __m256i *)(mb->sec_delta + i + 4)));
+        _mm256_storeu_si256((__m256i *)(mb->delta + i), lo);
+        _mm256_storeu_si256((__m256i *)(mb->delta + i + 4), hi);
+    }
+#endif
+    for (; i < mb->len; i++)
+    {
+        int32_t d = (mb->l_to[i] - mb->l_from[i] + 1) + ((mb->r_to[i] - mb->r_from[i] + 1) & mb->swap[i]);
+        mb->delta[i] = 2 * (int64_t)d + mb->sec_delta[i];
+    }
+}
+
+// The candidate to apply at temperature, -1 for none. With best_of the
+// candidate of least delta is taken under the Metropolis rule, otherwise
+// the first one the rule accepts, as if they had been proposed one after
+// the other.
+int move_batch_pick(const MoveBatch *mb, Rng *rng, double temperature, int best_of)
+{
+    if (mb->len == 0)
+        return -1;
+    if (best_of)
+    {
+        size_t best = 0;
+        for (size_t i = 1; i < mb->len; i++)
+        {
+            if (mb->delta[i] < mb->delta[best])
+                best = i;
+        }
+        if (mb->delta[best] <= 0 || rng_double(rng) < exp(-((double)mb->delta[best]) / temperature))
+            return (int)best;
+        return -1;
+    }
+    for (size_t i = 0; i < mb->len; i++)
+    {
+        if (mb->delta[i] <= 0 || rng_double(rng) < exp(-((double)mb->delta[i]) / temperature))
+            return (int)i;
+    }
+    return -1;
+}
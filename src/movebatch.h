@@ -0,0 +1,40 @@
+#ifndef MOVEBATCH_H
+#define MOVEBATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "anneal.h"
+
+// Candidate moves of one batched annealing step in structure-of-arrays form.
+// Only single swaps and relocations within a section are batched. Their
+// deltas depend on the visit counts of at most two staffs and, for a
+// relocation, on the capacity term of the section. move_batch_fill gathers
+// those counts into contiguous lanes, move_batch_deltas turns all of them
+// into energy deltas in one straight-line pass, and move_batch_pick chooses
+// at most one candidate to apply. All candidates are scored against the
+// same state.
+typedef struct MoveBatch
+{
+    size_t cap;
+    size_t len;
+    Move *moves;
+    /// visits of staff l to rooms a and b
+    int32_t *l_from, *l_to;
+    /// visits of staff r to rooms b and a, unused for a relocation
+    int32_t *r_from, *r_to;
+    /// all bits set for a swap, 0 for a relocation
+    int32_t *swap;
+    /// change of the section's capacity term, 0 for a swap
+    int64_t *sec_delta;
+    int64_t *delta;
+} MoveBatch;
+
+int move_batch_init(MoveBatch *mb, size_t cap);
+void move_batch_free(MoveBatch *mb);
+long long relocate_section_delta(const Timetable *tt, const EnergyState *st, const Room *rooms, size_t sec, int a, int b);
+void move_batch_fill(MoveBatch *mb, const Timetable *tt, const EnergyState *st, const Room *rooms, Rng *rng, size_t k);
+void move_batch_deltas(MoveBatch *mb);
+int move_batch_pick(const MoveBatch *mb, Rng *rng, double temperature, int best_of);
+
+#endif
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <z3.h>
+
+#include "anneal.h"
+#include "schedule.h"
+
+// Hybrid pipeline: the greedy constructor and the annealer from anneal.c
+// produce a schedule first, and Z3 only has to repair or confirm it.
+//
+// The annealer's sections are the rows of schedule_input and its room
+// capacities are the cols_y upper bounds. Its energy penalises people who
+// visit a room twice and rooms that are filled unevenly, which is what the
+// "every room once" and bound constraints ask for, so its answer is usually
+// feasible or close to it.
+
+/**
+   \brief The rooms of input as the annealer sees them, allocated from arena.
+
+   Return NULL when there are fewer than two rooms, they cannot hold
+   everyone or memory runs out.
+*/
+Room *input_rooms(const schedule_input *input, Arena *arena)
+{
+    size_t total = 0;
+    for (size_t c = 0; c < input->cols_len; c++)
+    {
+        total += input->cols_y[c];
+    }
+    if (input->row == 0 || input->cols_len < 2 || total < input->n_people)
+        return NULL;
+
+    Room *rooms = (Room *)arena_alloc(arena, sizeof(Room) * input->cols_len);
+    if (rooms == NULL)
+        return NULL;
+    for (size_t c = 0; c < input->cols_len; c++)
+    {
+        rooms[c].name = NULL;
+        rooms[c].cap = input->cols_y[c] < input->n_people ? (int)input->cols_y[c] : (int)input->n_people;
+    }
+    return rooms;
+}
+
+/**
+   \brief Write the annealed room of person i in row r to hint[i * input->row + r].
+
+   Return 1 when the rooms cannot hold everyone, or the greedy constructor
+   cannot seat everyone where input->eligible allows, and no hint is made.
+*/
+int heuristic_hint(const schedule_input *input, uint64_t seed, int *hint)
+{
+    Arena arena;
+    arena_init(&arena, 0);
+    Room *rooms = input_rooms(input, &arena);
+    if (rooms == NULL)
+    {
+        arena_free(&arena);
+        return 1;
+    }
+
+    Timetable tt;
+    int ret = solve_from(rooms, input->cols_len, input->row, input->n_people, NULL, input->eligible, &tt);
+    if (ret == 0)
+    {
+        Rng rng;
+        rng_seed(&rng, seed);
+        AnnealConfig cfg;
+        anneal_default_config(&cfg);
+        cfg.eligible = input->eligible;
+        ret = simulated_annealing(&tt, rooms, &rng, &cfg, NULL);
+    }
+    if (ret == 0)
+    {
+        for (size_t i = 0; i < input->n_people; i++)
+        {
+            for (size_t r = 0; r < input->row; r++)
+            {
+                hint[i * input->row + r] = tt.room_of[r * tt.n_staffs + i];
+            }
+        }
+    }
+
+    timetable_free(&tt);
+    arena_free(&arena);
+    return ret;
+}
+
+/**
+   \brief Solve input with Z3, seeded by the heuristic schedule when one can be made.
+*/
+int schedule_hybrid(const schedule_input input, uint64_t seed, schedule_result *result, schedule_stats *stats)
+{
+    int *hint = (int *)malloc(sizeof(int) * (input.n_people * input.row + 1));
+    if (hint == NULL)
+        return 1;
+
+    double start = now_seconds();
+    schedule_input hinted = input;
+    if (heuristic_hint(&input, seed, hint) == 0)
+        hinted.hint = hint;
+    double hinted_at = now_seconds();
+
+    int ret = schedule_run(hinted, result, stats);
+    if (stats != NULL)
+        stats->hint_seconds = hinted_at - start;
+
+    free(hint);
+    return ret;
+}
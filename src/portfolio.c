@@ -0,0 +1,264 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <z3.h>
+
+#include "schedule.h"
+
+// Portfolio solving: the same instance is built in one context per worker
+// thread, and the workers differ in solver kind, random seed and phase
+// selection. The first worker to return sat or unsat wins and stops the
+// others with Z3_interrupt, which is the only Z3 call that may be made on a
+// context from another thread.
+//
+// Contexts are registered in the shared state from just before their check
+// until they are deleted, and interrupts are sent under the same lock, so a
+// context is never interrupted after its worker has deleted it. A worker
+// that finds a winner when it is about to check does not check at all.
+
+typedef enum _portfolio_solver_
+{
+    PORTFOLIO_DEFAULT,
+    /// the QF_FD solver, a SAT core with cardinality and PB support
+    PORTFOLIO_FD,
+    /// the SMT core without the preprocessing tactics
+    PORTFOLIO_SIMPLE,
+} portfolio_solver;
+
+typedef struct _portfolio_shared_
+{
+    pthread_mutex_t lock;
+    const schedule_input *input;
+    Z3_context *ctxs;
+    size_t n_workers;
+    /// index of the first conclusive worker, -1 while there is none
+    int winner;
+} portfolio_shared;
+
+typedef struct _portfolio_worker_
+{
+    portfolio_shared *shared;
+    size_t id;
+    schedule_result result;
+    schedule_stats stats;
+    int ret;
+} portfolio_worker;
+
+/**
+   \brief Create the solver of worker id, every worker gets a different mix of settings.
+*/
+Z3_solver mk_portfolio_solver(Z3_context ctx, const schedule_input *input, size_t id)
+{
+    // smt.phase_selection and sat.phase values that mean roughly the same
+    unsigned smt_phases[] = {3, 0, 1, 2};
+    const char *sat_phases[] = {"caching", "always_false", "always_true", "random"};
+
+    portfolio_solver kind = (portfolio_solver)(id % 3);
+    // the SAT core cannot take the Int array encoding
+    if (kind == PORTFOLIO_FD && input->encoding != ENCODING_PB)
+        kind = PORTFOLIO_DEFAULT;
+
+    Z3_solver solver;
+    if (kind == PORTFOLIO_FD)
+        solver = Z3_mk_solver_for_logic(ctx, Z3_mk_string_symbol(ctx, "QF_FD"));
+    else if (kind == PORTFOLIO_SIMPLE)
+        solver = Z3_mk_simple_solver(ctx);
+    else
+        solver = Z3_mk_solver(ctx);
+    Z3_solver_inc_ref(ctx, solver);
+
+    Z3_params params = Z3_mk_params(ctx);
+    Z3_params_inc_ref(ctx, params);
+    Z3_params_set_uint(ctx, params, Z3_mk_string_symbol(ctx, "random_seed"), (unsigned)id);
+    // every solver kind only accepts the parameters of its own core
+    if (kind == PORTFOLIO_FD)
+        Z3_params_set_symbol(ctx, params, Z3_mk_string_symbol(ctx, "sat.phase"),
+                             Z3_mk_string_symbol(ctx, sat_phases[id / 3 % 4]));
+    else
+        Z3_params_set_uint(ctx, params,
+                           Z3_mk_string_symbol(ctx, kind == PORTFOLIO_SIMPLE ? "phase_selection" : "smt.phase_selection"),
+                           smt_phases[id / 3 % 4]);
+    if (input->timeout_ms != 0)
+        Z3_params_set_uint(ctx, params, Z3_mk_string_symbol(ctx, "timeout"), input->timeout_ms);
+    Z3_solver_set_params(ctx, solver, params);
+    Z3_params_dec_ref(ctx, params);
+    return solver;
+}
+
+void *portfolio_worker_main(void *arg)
+{
+    portfolio_worker *w = (portfolio_worker *)arg;
+    portfolio_shared *sh = w->shared;
+    const schedule_input *input = sh->input;
+    memset(&w->stats, 0, sizeof(schedule_stats));
+
+    double start = now_seconds();
+    schedule_scope sc;
+    schedule_scope_open(&sc);
+    Z3_context ctx = sc.ctx;
+    pthread_mutex_lock(&sh->lock);
+    int lost = sh->winner >= 0;
+    pthread_mutex_unlock(&sh->lock);
+    if (lost)
+    {
+        schedule_scope_close(&sc);
+        return NULL;
+    }
+
+    sc.solver = mk_portfolio_solver(ctx, input, w->id);
+    Z3_solver solver = sc.solver;
+    Z3_ast *cells = build_model(&sc, *input);
+    if (cells == NULL || (input->max_co_assign > 0 &&
+                          assert_co_assign(ctx, solver, *input, cells, input->max_co_assign, NULL, &sc.arena) != 0))
+    {
+        w->ret = 1;
+        goto done;
+    }
+
+    // the context is only published now, Z3_solver_check does not see an
+    // interrupt sent while the model was being built
+    pthread_mutex_lock(&sh->lock);
+    lost = sh->winner >= 0;
+    if (!lost)
+        sh->ctxs[w->id] = ctx;
+    pthread_mutex_unlock(&sh->lock);
+    if (lost)
+        goto done;
+
+    double built = now_seconds();
+    Z3_lbool res = Z3_solver_check(ctx, solver);
+    double checked = now_seconds();
+
+    pthread_mutex_lock(&sh->lock);
+    int won = res != Z3_L_UNDEF && sh->winner < 0;
+    if (won)
+    {
+        sh->winner = (int)w->id;
+        for (size_t i = 0; i < sh->n_workers; i++)
+        {
+            if (i != w->id && sh->ctxs[i] != NULL)
+                Z3_interrupt(sh->ctxs[i]);
+        }
+    }
+    pthread_mutex_unlock(&sh->lock);
+    if (!won)
+        goto done;
+
+    w->result.status = res;
+    if (res == Z3_L_TRUE)
+        w->ret = extract_entries(ctx, Z3_solver_get_model(ctx, solver), input, cells, &w->result);
+    w->stats.build_seconds = built - start;
+    w->stats.check_seconds = checked - built;
+    w->stats.extract_seconds = now_seconds() - checked;
+    if (collect_stats(ctx, solver, &w->stats) != 0)
+        w->ret = 1;
+
+done:
+    pthread_mutex_lock(&sh->lock);
+    sh->ctxs[w->id] = NULL;
+    pthread_mutex_unlock(&sh->lock);
+    schedule_scope_close(&sc);
+    return NULL;
+}
+
+/**
+   \brief Solve input with n_workers differently configured solvers in parallel.
+
+   n_workers == 0 uses one worker per online CPU. On return result holds the
+   answer of the first worker that found sat or unsat, and *winner its index,
+   or -1 when every worker gave up (result->status is then Z3_L_UNDEF).
+   stats may be NULL.
+*/
+int schedule_portfolio(const schedule_input input, size_t n_workers, schedule_result *result, int *winner, schedule_stats *stats)
+{
+    if (n_workers == 0)
+    {
+        long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n_workers = n_cpus > 0 ? (size_t)n_cpus : 1;
+    }
+    *winner = -1;
+    if (stats != NULL)
+        memset(stats, 0, sizeof(schedule_stats));
+    if (init_schedule_result(result, input.n_people) != 0)
+        return 1;
+
+    portfolio_shared sh;
+    sh.input = &input;
+    sh.n_workers = n_workers;
+    sh.winner = -1;
+    sh.ctxs = (Z3_context *)calloc(n_workers, sizeof(Z3_context));
+    portfolio_worker *workers = (portfolio_worker *)calloc(n_workers, sizeof(portfolio_worker));
+    pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * n_workers);
+    if (sh.ctxs == NULL || workers == NULL || threads == NULL)
+    {
+        free(sh.ctxs);
+        free(workers);
+        free(threads);
+        return 1;
+    }
+    pthread_mutex_init(&sh.lock, NULL);
+
+    int ret = 0;
+    size_t started = 0;
+    for (; started < n_workers; started++)
+    {
+        portfolio_worker *w = workers + started;
+        w->shared = &sh;
+        w->id = started;
+        if (init_schedule_result(&w->result, input.n_people) != 0 ||
+            pthread_create(threads + started, NULL, portfolio_worker_main, w) != 0)
+        {
+            free_schedule_result(&w->result);
+            ret = 1;
+            break;
+        }
+    }
+    if (ret != 0)
+    {
+        // stop the workers that did start
+        pthread_mutex_lock(&sh.lock);
+        if (sh.winner < 0)
+            sh.winner = (int)n_workers;
+        for (size_t i = 0; i < started; i++)
+        {
+            if (sh.ctxs[i] != NULL)
+                Z3_interrupt(sh.ctxs[i]);
+        }
+        pthread_mutex_unlock(&sh.lock);
+    }
+
+    for (size_t i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    if (ret == 0 && sh.winner >= 0)
+    {
+        portfolio_worker *w = workers + sh.winner;
+        *winner = sh.winner;
+        ret = w->ret;
+        free_schedule_result(result);
+        *result = w->result;
+        memset(&w->result, 0, sizeof(schedule_result));
+        if (stats != NULL)
+            *stats = w->stats;
+        else
+            free_schedule_stats(&w->stats);
+        memset(&w->stats, 0, sizeof(schedule_stats));
+    }
+    for (size_t i = 0; i < started; i++)
+    {
+        free_schedule_result(&workers[i].result);
+        free_schedule_stats(&workers[i].stats);
+    }
+
+    pthread_mutex_destroy(&sh.lock);
+    free(sh.ctxs);
+    free(workers);
+    free(threads);
+    return ret;
+}
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <z3.h>
+
+#include "schedule.h"
+
+// Rolling-horizon solve for long schedules. Instead of one model over all
+// rows, a model over `window` rows is solved at a time. Its first
+// window - overlap rows are then fixed, and what they did is carried into
+// the next window as data: the rooms every person has visited
+// (input.visited) and the rows every pair has shared (input.co_used). The
+// last `overlap` rows of a window are solved again as the first rows of the
+// next one, which lets a window revise what its predecessor planned for
+// them. Every model has the same size, so the time grows with the number of
+// windows rather than with the size of the whole model.
+//
+// A window also keeps enough people who have not visited a room for the
+// rows after it (assert_rooms_left). It cannot foresee everything, e.g. the
+// pair budget a later window needs, so unsat means that the rolling solve got
+// stuck, not that the instance is infeasible.
+
+// add the pairs that share a room in row r of the window to co_used
+void rolling_count_pairs(const schedule_input *input, const schedule_result *win, size_t r, int *room_of, int *co_used)
+{
+    size_t n = input->n_people;
+    for (size_t i = 0; i < n; i++)
+    {
+        room_of[i] = NO_ASSIGN;
+    }
+    for (size_t e = 0; e < win->entry_cnt; e++)
+    {
+        if (win->entries[e].row == r)
+            room_of[win->entries[e].person] = (int)win->entries[e].col;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t j = i + 1; j < n; j++)
+        {
+            if (room_of[i] != NO_ASSIGN && room_of[i] == room_of[j])
+            {
+                co_used[i * n + j]++;
+                co_used[j * n + i]++;
+            }
+        }
+    }
+}
+
+/**
+   \brief Solve input window rows at a time, solving the last overlap rows of every window again in the next.
+
+   Requires 0 <= overlap < window. input.timeout_ms bounds the whole solve
+   and input.hint, if any, is split among the windows. The rows fixed so far
+   are kept in result even when a window ends unsat or unknown.
+*/
+int schedule_rolling(const schedule_input input, size_t window, size_t overlap, schedule_result *result, schedule_stats *stats)
+{
+    if (stats != NULL)
+        memset(stats, 0, sizeof(schedule_stats));
+    if (init_schedule_result(result, input.n_people) != 0)
+        return 1;
+    if (window == 0 || overlap >= window)
+        return 1;
+
+    size_t n = input.n_people;
+    size_t *visited = (size_t *)calloc(n * input.cols_len, sizeof(size_t));
+    int *co_used = (int *)calloc(n * n, sizeof(int));
+    int *room_of = (int *)malloc(sizeof(int) * n);
+    int *hint = input.hint != NULL ? (int *)malloc(sizeof(int) * n * window) : NULL;
+    result->entries = (schedule_entry *)arena_alloc(&result->arena, sizeof(schedule_entry) * n * input.row);
+    if (visited == NULL || co_used == NULL || room_of == NULL || (input.hint != NULL && hint == NULL) ||
+        result->entries == NULL)
+    {
+        free(visited);
+        free(co_used);
+        free(room_of);
+        free(hint);
+        return 1;
+    }
+
+    double deadline = input.timeout_ms > 0 ? now_seconds() + input.timeout_ms / 1000.0 : 0;
+    int ret = 0;
+    result->status = Z3_L_TRUE;
+    for (size_t start = 0; start < input.row && ret == 0;)
+    {
+        size_t end = start + window < input.row ? start + window : input.row;
+        size_t commit = end == input.row ? end : end - overlap;
+
+        schedule_input sub = input;
+        sub.row = end - start;
+        sub.visited = visited;
+        sub.co_used = co_used;
+        sub.rows_after = input.row - end;
+        // the window sees the eligibility of its rows and of those after it
+        Eligibility sub_el;
+        if (input.eligible != NULL)
+        {
+            eligibility_window(&sub_el, input.eligible, start, input.row - start);
+            sub.eligible = &sub_el;
+        }
+        if (deadline > 0)
+        {
+            double left = deadline - now_seconds();
+            if (left <= 0)
+            {
+                result->status = Z3_L_UNDEF;
+                break;
+            }
+            sub.timeout_ms = (unsigned)(left * 1000) + 1;
+        }
+        if (hint != NULL)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                memcpy(hint + i * sub.row, input.hint + i * input.row + start, sizeof(int) * sub.row);
+            }
+            sub.hint = hint;
+        }
+
+        schedule_result win;
+        schedule_stats win_stats;
+        ret = schedule_run(sub, &win, stats != NULL ? &win_stats : NULL);
+        if (stats != NULL)
+        {
+            stats->build_seconds += win_stats.build_seconds;
+            stats->check_seconds += win_stats.check_seconds;
+            stats->extract_seconds += win_stats.extract_seconds;
+            stats->hints_total += win_stats.hints_total;
+            stats->hints_kept += win_stats.hints_kept;
+            stats->windows++;
+            free_schedule_stats(&win_stats);
+        }
+        if (ret == 0 && win.status != Z3_L_TRUE)
+            result->status = win.status;
+        if (ret != 0 || win.status != Z3_L_TRUE)
+        {
+            free_schedule_result(&win);
+            break;
+        }
+
+        // fix the rows before the overlap and carry their history forward
+        for (size_t e = 0; e < win.entry_cnt; e++)
+        {
+            schedule_entry *entry = win.entries + e;
+            if (start + entry->row >= commit)
+                continue;
+            visited[entry->person * input.cols_len + entry->col]++;
+            schedule_entry *out = result->entries + result->entry_cnt++;
+            out->row = start + entry->row;
+            out->col = entry->col;
+            out->person = entry->person;
+            out->name = result->names[entry->person];
+        }
+        for (size_t r = 0; r < commit - start; r++)
+        {
+            rolling_count_pairs(&sub, &win, r, room_of, co_used);
+        }
+        free_schedule_result(&win);
+        start = commit;
+    }
+
+    free(visited);
+    free(co_used);
+    free(room_of);
+    free(hint);
+    return ret;
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+#include "executor.h"
+#include "scheduler.h"
+
+// usage: sched_batch [-e anneal|z3|hybrid] [-t ms] [-j threads] [-s seed] [-o results.jsonl] instances
+//        sched_batch -c instances.bin instances
+// Solves every instance of the file on a pool of threads (-j 0, the
+// default, uses one per CPU) and writes one JSON line per instance, in file
+// order, as soon as it and all before it are done. -t is the time budget of
+// each instance. -c converts a file (text or binary) to the binary form
+// instead of solving it.
+
+void write_result(size_t id, int ret, const scheduler_solution *sol, void *user)
+{
+    batch_write_result((FILE *)user, id, ret, sol);
+}
+
+int main(int argc, char **argv)
+{
+    executor_config cfg;
+    executor_default_config(&cfg);
+    scheduler_options opts = cfg.base;
+    const char *in_path = NULL, *out_path = NULL, *bin_path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+        {
+            i++;
+            opts.engine = strcmp(argv[i], "anneal") == 0 ? SCHEDULER_ANNEAL
+                          : strcmp(argv[i], "z3") == 0   ? SCHEDULER_Z3
+                                                         : SCHEDULER_HYBRID;
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            cfg.timeout = strtod(argv[++i], NULL) / 1000;
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            cfg.n_threads = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            opts.seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            out_path = argv[++i];
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            bin_path = argv[++i];
+        else if (argv[i][0] != '-' && in_path == NULL)
+            in_path = argv[i];
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (in_path == NULL)
+    {
+        fprintf(stderr, "no instance file\n");
+        return 1;
+    }
+
+    batch_reader br;
+    if (batch_open(&br, in_path) != 0)
+    {
+        perror(in_path);
+        return 1;
+    }
+    FILE *out = bin_path != NULL ? fopen(bin_path, "wb") : out_path != NULL ? fopen(out_path, "w") : stdout;
+    if (out == NULL)
+    {
+        perror(bin_path != NULL ? bin_path : out_path);
+        batch_close(&br);
+        return 1;
+    }
+    int ret = 0;
+    if (bin_path != NULL)
+    {
+        size_t id = 0;
+        int r = batch_write_header(out);
+        scheduler_instance inst;
+        while (r == 0 && (r = batch_next(&br, &inst)) == 0)
+        {
+            r = batch_write_instance(out, &inst);
+            id += r == 0;
+        }
+        if (r != 1 || batch_finish(out, id) != 0)
+        {
+            fprintf(stderr, "%s: conversion stopped at instance %zu\n", in_path, id);
+            ret = 1;
+        }
+    }
+    else
+    {
+        scheduler_instance *insts;
+        size_t *bounds, n;
+        if (batch_load(&br, &insts, &bounds, &n) != 0)
+        {
+            if (br.binary)
+                fprintf(stderr, "%s: malformed record %zu\n", in_path, n);
+            else
+                fprintf(stderr, "%s:%zu: malformed instance\n", in_path, br.line);
+            ret = 1;
+        }
+        else
+        {
+            cfg.base = opts;
+            cfg.deliver = write_result;
+            cfg.user = out;
+            ret = executor_run(&cfg, insts, n) != 0;
+        }
+        free(insts);
+        free(bounds);
+    }
+
+    if (out != stdout)
+        fclose(out);
+    batch_close(&br);
+    return ret;
+}
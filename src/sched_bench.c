@@ -0,0 +1,400 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <z3.h>
+
+#include "schedule.h"
+
+// Benchmark driver for schedule_run(). Every instance is solved in a forked
+// child so that its peak RSS is measured on its own, and one JSON object per
+// run is written to the output file (stdout by default).
+
+#define MAX_COLS 16
+
+typedef struct _bench_instance_
+{
+    const char *family;
+    /// sat, unsat, or unknown when it depends on max_co_assign
+    const char *expect;
+    size_t row;
+    size_t cols_len;
+    size_t n_people;
+    size_t cols_x[MAX_COLS];
+    size_t cols_y[MAX_COLS];
+    int max_co_assign;
+    /// rooms every person is qualified for, a window starting at its own index, 0 for all
+    size_t qualified;
+} bench_instance;
+
+typedef struct _bench_list_
+{
+    bench_instance *items;
+    size_t len;
+    size_t cap;
+} bench_list;
+
+bench_instance *bench_push(bench_list *list)
+{
+    if (list->len == list->cap)
+    {
+        size_t cap = list->cap == 0 ? 64 : list->cap * 2;
+        bench_instance *items = (bench_instance *)realloc(list->items, sizeof(bench_instance) * cap);
+        if (items == NULL)
+            return NULL;
+        list->items = items;
+        list->cap = cap;
+    }
+    bench_instance *inst = list->items + list->len++;
+    memset(inst, 0, sizeof(bench_instance));
+    return inst;
+}
+
+void set_bounds(bench_instance *inst, size_t x, size_t y)
+{
+    for (size_t c = 0; c < inst->cols_len; c++)
+    {
+        inst->cols_x[c] = x;
+        inst->cols_y[c] = y;
+    }
+}
+
+/**
+   \brief Generate the instance families, keeping those named by family (NULL for all).
+
+   square:    k rows and k rooms, bounds floor(n / k)..ceil(n / k), several co-assign limits
+   tight:     n = m * k people with exact bounds m, the co-assign limit decides feasibility
+   mixed:     alternating narrow and wide rooms, only some rooms are interchangeable
+   overfull:  the lower bounds need more people than exist (unsat)
+   rect:      one more room than rows, nobody can visit every room (unsat)
+   restricted: everyone is qualified for half of the rooms only, so sits in
+              some of them more than once
+*/
+int generate(bench_list *list, const char *family, size_t max_k, size_t max_people)
+{
+    for (size_t k = 3; k <= max_k && k <= MAX_COLS; k++)
+    {
+        for (size_t n = 2 * k; n <= 4 * k && n <= max_people; n += k / 2 + 1)
+        {
+            size_t lo = n / k, hi = (n + k - 1) / k;
+            int cos[] = {0, 3, 2, 1};
+            for (size_t ci = 0; ci < sizeof(cos) / sizeof(int); ci++)
+            {
+                if (family == NULL || strcmp(family, "square") == 0)
+                {
+                    bench_instance *inst = bench_push(list);
+                    if (inst == NULL)
+                        return 1;
+                    inst->family = "square";
+                    inst->expect = cos[ci] == 0 ? "sat" : "unknown";
+                    inst->row = inst->cols_len = k;
+                    inst->n_people = n;
+                    inst->max_co_assign = cos[ci];
+                    set_bounds(inst, lo, hi);
+                }
+                if ((family == NULL || strcmp(family, "mixed") == 0) && hi > 1)
+                {
+                    bench_instance *inst = bench_push(list);
+                    if (inst == NULL)
+                        return 1;
+                    inst->family = "mixed";
+                    inst->expect = "unknown";
+                    inst->row = inst->cols_len = k;
+                    inst->n_people = n;
+                    inst->max_co_assign = cos[ci];
+                    for (size_t c = 0; c < k; c++)
+                    {
+                        inst->cols_x[c] = c % 2 == 0 ? lo : lo - 1;
+                        inst->cols_y[c] = c % 2 == 0 ? hi : hi + 1;
+                    }
+                }
+            }
+
+            if (family == NULL || strcmp(family, "overfull") == 0)
+            {
+                bench_instance *inst = bench_push(list);
+                if (inst == NULL)
+                    return 1;
+                inst->family = "overfull";
+                inst->expect = "unsat";
+                inst->row = inst->cols_len = k;
+                inst->n_people = n;
+                inst->max_co_assign = 2;
+                set_bounds(inst, hi + 1, hi + 2);
+            }
+
+            if ((family == NULL || strcmp(family, "rect") == 0) && k + 1 <= MAX_COLS)
+            {
+                bench_instance *inst = bench_push(list);
+                if (inst == NULL)
+                    return 1;
+                inst->family = "rect";
+                inst->expect = "unsat";
+                inst->row = k;
+                inst->cols_len = k + 1;
+                inst->n_people = n;
+                inst->max_co_assign = 2;
+                set_bounds(inst, 0, n);
+            }
+
+            if ((family == NULL || strcmp(family, "restricted") == 0) && k >= 4)
+            {
+                bench_instance *inst = bench_push(list);
+                if (inst == NULL)
+                    return 1;
+                inst->family = "restricted";
+                inst->expect = "sat";
+                inst->row = inst->cols_len = k;
+                inst->n_people = n;
+                inst->max_co_assign = 0;
+                inst->qualified = k / 2;
+                set_bounds(inst, 0, n);
+            }
+        }
+
+        for (size_t m = 2; m * k <= max_people && m <= 4; m++)
+        {
+            for (int co = (int)k; co >= 1; co--)
+            {
+                if (family == NULL || strcmp(family, "tight") == 0)
+                {
+                    bench_instance *inst = bench_push(list);
+                    if (inst == NULL)
+                        return 1;
+                    inst->family = "tight";
+                    inst->expect = "unknown";
+                    inst->row = inst->cols_len = k;
+                    inst->n_people = m * k;
+                    inst->max_co_assign = co;
+                    set_bounds(inst, m, m);
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+void print_json_string(FILE *out, const char *s)
+{
+    fputc('"', out);
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', out);
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+void print_json_sizes(FILE *out, const size_t *xs, size_t len)
+{
+    fputc('[', out);
+    for (size_t i = 0; i < len; i++)
+    {
+        fprintf(out, i == 0 ? "%zu" : ",%zu", xs[i]);
+    }
+    fputc(']', out);
+}
+
+/**
+   \brief Solve one instance and write its record, run inside the child process.
+
+   Return 4 when Z3 decides it the other way from inst->expect.
+*/
+int run_one(FILE *out, const bench_instance *inst, size_t id, schedule_encoding encoding, int sym, unsigned timeout_ms)
+{
+    schedule_input input;
+    input.row = inst->row;
+    input.cols_len = inst->cols_len;
+    input.cols_x = (size_t *)inst->cols_x;
+    input.cols_y = (size_t *)inst->cols_y;
+    input.n_people = inst->n_people;
+    input.max_co_assign = inst->max_co_assign;
+    input.encoding = encoding;
+    input.symmetry_breaking = sym;
+    input.timeout_ms = timeout_ms;
+    input.hint = NULL;
+    input.interrupt = NULL;
+    input.visited = NULL;
+    input.co_used = NULL;
+    input.rows_after = 0;
+    input.eligible = NULL;
+    Arena arena;
+    arena_init(&arena, 0);
+    Eligibility el;
+    if (inst->qualified > 0)
+    {
+        if (eligibility_init(&el, inst->n_people, inst->row, inst->cols_len, &arena) != 0)
+        {
+            arena_free(&arena);
+            return 1;
+        }
+        for (size_t i = 0; i < inst->n_people; i++)
+        {
+            for (size_t c = 0; c < inst->cols_len; c++)
+            {
+                size_t offset = (c + inst->cols_len - i % inst->cols_len) % inst->cols_len;
+                eligibility_set_room(&el, (int)i, c, offset < inst->qualified);
+            }
+        }
+        input.eligible = &el;
+    }
+
+    schedule_result result;
+    schedule_stats stats;
+    int ret = schedule_run(input, &result, &stats);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    const char *status = ret != 0                       ? "error"
+                         : result.status == Z3_L_TRUE  ? "sat"
+                         : result.status == Z3_L_FALSE ? "unsat"
+                                                       : "unknown";
+
+    fprintf(out, "{\"id\":%zu,\"family\":\"%s\",\"expect\":\"%s\",\"row\":%zu,\"cols_len\":%zu,\"n_people\":%zu,",
+            id, inst->family, inst->expect, inst->row, inst->cols_len, inst->n_people);
+    fprintf(out, "\"cols_x\":");
+    print_json_sizes(out, inst->cols_x, inst->cols_len);
+    fprintf(out, ",\"cols_y\":");
+    print_json_sizes(out, inst->cols_y, inst->cols_len);
+    fprintf(out, ",\"max_co_assign\":%d,\"qualified\":%zu,", inst->max_co_assign, inst->qualified);
+    fprintf(out, "\"encoding\":\"%s\",\"symmetry_breaking\":%d,\"timeout_ms\":%u,",
+            encoding == ENCODING_PB ? "pb" : "int_array", sym, timeout_ms);
+    fprintf(out, "\"result\":\"%s\",\"build_s\":%.6f,\"check_s\":%.6f,\"extract_s\":%.6f,\"peak_rss_kb\":%ld,\"z3\":{",
+            status, stats.build_seconds, stats.check_seconds, stats.extract_seconds, usage.ru_maxrss);
+    for (size_t i = 0; i < stats.n_stats; i++)
+    {
+        if (i > 0)
+            fputc(',', out);
+        print_json_string(out, stats.stat_keys[i]);
+        fprintf(out, ":%.17g", stats.stat_values[i]);
+    }
+    fprintf(out, "}}\n");
+    fflush(out);
+
+    free_schedule_result(&result);
+    free_schedule_stats(&stats);
+    arena_free(&arena);
+    if (ret == 0 && strcmp(inst->expect, status) != 0 && strcmp(inst->expect, "unknown") != 0 &&
+        strcmp(status, "unknown") != 0)
+        ret = 4;
+    return ret;
+}
+
+// usage: sched_bench [-o results.jsonl] [-f family] [-e int|pb|both] [-sym 0|1|both]
+//                    [-t timeout_ms] [-k max_rooms] [-n max_people] [-l]
+// -l only lists the generated instances
+// A run fails when it errors or contradicts the instance's expected sat/unsat.
+int main(int argc, char **argv)
+{
+    const char *out_path = NULL;
+    const char *family = NULL;
+    int encodings[] = {1, 1};
+    int syms[] = {1, 1};
+    unsigned timeout_ms = 10000;
+    size_t max_k = 6, max_people = 24;
+    int list_only = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            out_path = argv[++i];
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            family = argv[++i];
+        else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+        {
+            i++;
+            encodings[ENCODING_INT_ARRAY] = strcmp(argv[i], "pb") != 0;
+            encodings[ENCODING_PB] = strcmp(argv[i], "int") != 0;
+        }
+        else if (strcmp(argv[i], "-sym") == 0 && i + 1 < argc)
+        {
+            i++;
+            syms[0] = strcmp(argv[i], "1") != 0;
+            syms[1] = strcmp(argv[i], "0") != 0;
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            timeout_ms = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+            max_k = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            max_people = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-l") == 0)
+            list_only = 1;
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    bench_list list = {NULL, 0, 0};
+    if (generate(&list, family, max_k, max_people) != 0)
+        return 1;
+
+    if (list_only)
+    {
+        for (size_t i = 0; i < list.len; i++)
+        {
+            bench_instance *inst = list.items + i;
+            printf("%zu %s row=%zu cols=%zu people=%zu co=%d expect=%s\n", i, inst->family, inst->row,
+                   inst->cols_len, inst->n_people, inst->max_co_assign, inst->expect);
+        }
+        free(list.items);
+        return 0;
+    }
+
+    FILE *out = out_path == NULL ? stdout : fopen(out_path, "w");
+    if (out == NULL)
+    {
+        perror(out_path);
+        return 1;
+    }
+
+    int failed = 0;
+    for (size_t i = 0; i < list.len; i++)
+    {
+        for (int e = 0; e < 2; e++)
+        {
+            for (int sym = 0; sym < 2; sym++)
+            {
+                if (!encodings[e] || !syms[sym])
+                    continue;
+                fflush(out);
+                pid_t pid = fork();
+                if (pid < 0)
+                {
+                    perror("fork");
+                    fclose(out);
+                    free(list.items);
+                    return 1;
+                }
+                if (pid == 0)
+                {
+                    int ret = run_one(out, list.items + i, i, (schedule_encoding)e, sym, timeout_ms);
+                    fclose(out);
+                    _exit(ret);
+                }
+                int status;
+                waitpid(pid, &status, 0);
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                {
+                    fprintf(stderr, "instance %zu (%s, encoding %d, sym %d) failed\n", i, list.items[i].family, e, sym);
+                    failed++;
+                }
+            }
+        }
+        fprintf(stderr, "\r%zu/%zu", i + 1, list.len);
+    }
+    fprintf(stderr, "\n");
+
+    fclose(out);
+    free(list.items);
+    return failed != 0;
+}
@@ -0,0 +1,1096 @@
+#define _POSIX_C_SOURCE 200809L
+
+// some codes are copied from https://github.com/Z3Prover/z3/blob/master/examples/c/test_capi.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <memory.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+#include <z3.h>
+
+#include "anneal.h"
+#include "schedule.h"
+
+/**
+   \defgroup capi_ex C API examples
+*/
+/**@{*/
+/**
+   @name Auxiliary Functions
+*/
+/**@{*/
+
+/**
+   \brief exit gracefully in case of error.
+*/
+void exitf(const char *message)
+{
+    fprintf(stderr, "BUG: %s.\n", message);
+    exit(1);
+}
+
+/**
+   \brief exit if unreachable code was reached.
+*/
+void unreachable()
+{
+    exitf("unreachable code was reached");
+}
+
+/**
+   \brief Simpler error handler.
+ */
+void error_handler(Z3_context c, Z3_error_code e)
+{
+    printf("Error code: %d\n", e);
+    printf("Detail: %s\n", Z3_get_error_msg(c, e));
+    exitf("incorrect use of Z3");
+}
+
+static jmp_buf g_catch_buffer;
+/**
+   \brief Low tech exceptions.
+
+   In high-level programming languages, an error handler can throw an exception.
+*/
+void throw_z3_error(Z3_context c, Z3_error_code e)
+{
+    longjmp(g_catch_buffer, e);
+}
+
+/**
+   \brief Error handling that depends on checking an error code on the context.
+
+*/
+
+void nothrow_z3_error(Z3_context c, Z3_error_code e)
+{
+    // no-op
+}
+
+/**
+   \brief Create a logical context.
+
+   Enable model construction. Other configuration parameters can be passed in the cfg variable.
+
+   Also enable tracing to stderr and register custom error handler.
+*/
+Z3_context mk_context_custom(Z3_config cfg, Z3_error_handler err)
+{
+    Z3_context ctx;
+
+    Z3_set_param_value(cfg, "model", "true");
+    ctx = Z3_mk_context(cfg);
+    Z3_set_error_handler(ctx, err);
+
+    return ctx;
+}
+
+Z3_solver mk_solver(Z3_context ctx)
+{
+    Z3_solver s = Z3_mk_solver(ctx);
+    Z3_solver_inc_ref(ctx, s);
+    return s;
+}
+
+void del_solver(Z3_context ctx, Z3_solver s)
+{
+    Z3_solver_dec_ref(ctx, s);
+}
+
+/**
+   \brief Create a logical context.
+
+   Enable model construction only.
+
+   Also enable tracing to stderr and register standard error handler.
+*/
+Z3_context mk_context()
+{
+    Z3_config cfg;
+    Z3_context ctx;
+    cfg = Z3_mk_config();
+    ctx = mk_context_custom(cfg, error_handler);
+    Z3_del_config(cfg);
+    return ctx;
+}
+
+/**
+   \brief Open a scope with a fresh context and an empty arena, the caller sets sc->solver.
+*/
+void schedule_scope_open(schedule_scope *sc)
+{
+    sc->ctx = mk_context();
+    sc->solver = NULL;
+    arena_init(&sc->arena, 0);
+}
+
+/**
+   \brief Release the solver, the context and every block of the arena.
+*/
+void schedule_scope_close(schedule_scope *sc)
+{
+    if (sc->solver != NULL)
+        del_solver(sc->ctx, sc->solver);
+    Z3_del_context(sc->ctx);
+    arena_free(&sc->arena);
+    sc->ctx = NULL;
+    sc->solver = NULL;
+}
+
+/**
+   \brief Create a logical context.
+
+   Enable fine-grained proof construction.
+   Enable model construction.
+
+   Also enable tracing to stderr and register standard error handler.
+*/
+Z3_context mk_proof_context()
+{
+    Z3_config cfg = Z3_mk_config();
+    Z3_context ctx;
+    Z3_set_param_value(cfg, "proof", "true");
+    ctx = mk_context_custom(cfg, throw_z3_error);
+    Z3_del_config(cfg);
+    return ctx;
+}
+
+/**
+   \brief Create a variable using the given name and type.
+*/
+Z3_ast mk_var(Z3_context ctx, const char *name, Z3_sort ty)
+{
+    Z3_symbol s = Z3_mk_string_symbol(ctx, name);
+    return Z3_mk_const(ctx, s, ty);
+}
+
+
+/**
+   \brief Index of the (person, row, col) cell in the arrays returned by the encoders.
+*/
+size_t cell_index(const schedule_input *input, size_t i, size_t r, size_t c)
+{
+    return (i * input->row + r) * input->cols_len + c;
+}
+
+/**
+   \brief Sum of n Int terms, 0 when there are none.
+*/
+Z3_ast mk_int_sum(Z3_context ctx, size_t n, const Z3_ast *args)
+{
+    return n == 0 ? Z3_mk_int64(ctx, 0, Z3_mk_int_sort(ctx)) : Z3_mk_add(ctx, n, args);
+}
+
+/**
+   \brief Assert that at least lo and at most hi of the n Bool terms hold.
+
+   Z3 folds a pseudo-Boolean constraint over no terms to false whatever its
+   bound, so that case is decided here.
+*/
+void assert_count(Z3_context ctx, Z3_solver solver, size_t n, Z3_ast *args, int *coeffs, size_t lo, size_t hi)
+{
+    if (n == 0)
+    {
+        if (lo > 0)
+            Z3_solver_assert(ctx, solver, Z3_mk_false(ctx));
+        return;
+    }
+    if (lo == hi)
+    {
+        Z3_solver_assert(ctx, solver, Z3_mk_pbeq(ctx, n, args, coeffs, lo));
+        return;
+    }
+    if (lo > 0)
+        Z3_solver_assert(ctx, solver, Z3_mk_atleast(ctx, n, args, lo));
+    Z3_solver_assert(ctx, solver, Z3_mk_atmost(ctx, n, args, hi));
+}
+
+/**
+   \brief Bounds on how often restricted person i visits each room it is qualified for.
+
+   Its available rows are spread as evenly as they go over those rooms, as
+   every room is visited exactly once by people without restrictions.
+*/
+void restricted_visits(const schedule_input *input, size_t i, size_t *lo, size_t *hi)
+{
+    size_t rows = 0, rooms = eligible_rooms(input->eligible, (int)i);
+    for (size_t r = 0; r < input->row; r++)
+    {
+        rows += eligible_section(input->eligible, (int)i, r);
+    }
+    *lo = rooms == 0 ? 0 : rows / rooms;
+    *hi = rooms == 0 ? 0 : (rows + rooms - 1) / rooms;
+}
+
+/**
+   \brief Encode the instance with nested Int arrays.
+
+   Return one Bool term per (person, row, col) cell that holds when the person is assigned there. A cell
+   input.eligible rules out is false and its array entry 0, and the sums only add the eligible entries.
+*/
+Z3_ast *mk_int_array_model(Z3_context ctx, Z3_solver solver, const schedule_input input, Arena *arena)
+{
+    Z3_sort int_sort, array_sort, mat_sort, mat3_sort;
+    Z3_ast ms;
+
+    int_sort = Z3_mk_int_sort(ctx);
+    array_sort = Z3_mk_array_sort(ctx, int_sort, int_sort);
+    mat_sort = Z3_mk_array_sort(ctx, int_sort, array_sort);
+    mat3_sort = Z3_mk_array_sort(ctx, int_sort, mat_sort);
+    ms = mk_var(ctx, "m", mat3_sort);
+
+    Z3_ast *cells = (Z3_ast *)arena_alloc(arena, sizeof(Z3_ast) * input.n_people * input.row * input.cols_len);
+    Z3_ast *int_row = (Z3_ast *)arena_alloc(arena, sizeof(Z3_ast) * input.cols_len);
+    Z3_ast *int_col = (Z3_ast *)arena_alloc(arena, sizeof(Z3_ast) * input.row);
+    Z3_ast *assigns = (Z3_ast *)arena_alloc(arena, sizeof(Z3_ast) * input.n_people);
+    if (cells == NULL || int_row == NULL || int_col == NULL || assigns == NULL)
+        return NULL;
+
+    const Eligibility *el = input.eligible;
+    // for each people
+    for (size_t i = 0; i < input.n_people; i++)
+    {
+        // m = ms[i]
+        Z3_ast m = Z3_mk_select(ctx, ms, Z3_mk_int64(ctx, i, int_sort));
+        for (size_t r = 0; r < input.row; r++)
+        {
+            // row = m[r]
+            Z3_ast row = Z3_mk_select(ctx, m, Z3_mk_int64(ctx, r, int_sort));
+
+            size_t len = 0;
+            for (size_t c = 0; c < input.cols_len; c++)
+            {
+                if (!eligible(el, (int)i, r, c))
+                {
+                    cells[cell_index(&input, i, r, c)] = Z3_mk_false(ctx);
+                    continue;
+                }
+                // int_row[len] = row[c]
+                int_row[len] = Z3_mk_select(ctx, row, Z3_mk_int64(ctx, c, int_sort));
+                cells[cell_index(&input, i, r, c)] = Z3_mk_gt(ctx, int_row[len], Z3_mk_int64(ctx, 0, int_sort));
+                len++;
+            }
+            // row_sum = sum(int_row)
+            Z3_ast row_sum = mk_int_sum(ctx, len, int_row);
+            // assert(row_sum == 1), or 0 in a row the person is not available in
+            int64_t seated = eligible_section(el, (int)i, r) ? 1 : 0;
+            Z3_solver_assert(ctx, solver, Z3_mk_eq(ctx, row_sum, Z3_mk_int64(ctx, seated, int_sort)));
+        }
+
+        int unrestricted = eligibility_unrestricted(el, (int)i);
+        for (size_t c = 0; c < input.cols_len; c++)
+        {
+            // the person never sits in a room it is not qualified for
+            if (!eligible_room(el, (int)i, c))
+                continue;
+            size_t len = 0;
+            for (size_t r = 0; r < input.row; r++)
+            {
+                if (!eligible(el, (int)i, r, c))
+                    continue;
+                Z3_ast row = Z3_mk_select(ctx, m, Z3_mk_int64(ctx, r, int_sort));
+                int_col[len++] = Z3_mk_select(ctx, row, Z3_mk_int64(ctx, c, int_sort));
+            }
+            Z3_ast col_sum = mk_int_sum(ctx, len, int_col);
+            if (input.visited == NULL && unrestricted)
+            {
+                Z3_solver_assert(ctx, solver, Z3_mk_eq(ctx, col_sum, Z3_mk_int64(ctx, 1, int_sort)));
+            }
+            else if (input.visited == NULL)
+            {
+                size_t lo, hi;
+                restricted_visits(&input, i, &lo, &hi);
+                Z3_solver_assert(ctx, solver, Z3_mk_ge(ctx, col_sum, Z3_mk_int64(ctx, (int64_t)lo, int_sort)));
+                Z3_solver_assert(ctx, solver, Z3_mk_le(ctx, col_sum, Z3_mk_int64(ctx, (int64_t)hi, int_sort)));
+            }
+            else
+            {
+                // the rows still to come must leave room for the unvisited rooms
+                int64_t left = input.visited[i * input.cols_len + c] == 0 ? 1 : 0;
+                Z3_solver_assert(ctx, solver, Z3_mk_le(ctx, col_sum, Z3_mk_int64(ctx, left, int_sort)));
+            }
+        }
+
+        for (size_t r = 0; r < input.row; r++)
+        {
+            Z3_ast row = Z3_mk_select(ctx, m, Z3_mk_int64(ctx, r, int_sort));
+            for (size_t c = 0; c < input.cols_len; c++)
+            {
+                Z3_ast v = Z3_mk_select(ctx, row, Z3_mk_int64(ctx, c, int_sort));
+                // assert(v >= 0), or v == 0 where the person may not be assigned
+                if (eligible(el, (int)i, r, c))
+                    Z3_solver_assert(ctx, solver, Z3_mk_ge(ctx, v, Z3_mk_int64(ctx, 0, int_sort)));
+                else
+                    Z3_solver_assert(ctx, solver, Z3_mk_eq(ctx, v, Z3_mk_int64(ctx, 0, int_sort)));
+            }
+        }
+    }
+
+    for (size_t r = 0; r < input.row; r++)
+    {
+        for (size_t c = 0; c < input.cols_len; c++)
+        {
+            size_t len = 0;
+            for (size_t i = 0; i < input.n_people; i++)
+            {
+                if (!eligible(el, (int)i, r, c))
+                    continue;
+                Z3_ast m = Z3_mk_select(ctx, ms, Z3_mk_int64(ctx, i, int_sort));
+                Z3_ast row = Z3_mk_select(ctx, m, Z3_mk_int64(ctx, r, int_sort));
+                Z3_ast assign = Z3_mk_select(ctx, row, Z3_mk_int64(ctx, c, int_sort));
+                assigns[len++] = assign;
+            }
+            Z3_ast assign_total = mk_int_sum(ctx, len, assigns);
+
+            size_t x = input.cols_x[c];
+            size_t y = input.cols_y[c];
+            if (x == y)
+            {
+                Z3_solver_assert(ctx, solver, Z3_mk_eq(ctx, assign_total, Z3_mk_int64(ctx, x, int_sort)));
+            }
+            else
+            {
+                Z3_ast ge_mn = Z3_mk_ge(
+                    ctx,
+                    assign_total,
+                    Z3_mk_int64(ctx, x, int_sort));
+                Z3_ast le_mx = Z3_mk_le(
+                    ctx,
+                    assign_total,
+                    Z3_mk_int64(ctx, y, int_sort));
+                Z3_ast args[] = {ge_mn, le_mx};
+                Z3_solver_assert(
+                    ctx,
+                    solver,
+                    Z3_mk_and(ctx, 2, args));
+            }
+        }
+    }
+
+    return cells;
+}
+
+/**
+   \brief Encode the instance with one Bool constant per eligible (person, row, col).
+
+   Every sum becomes a pseudo-Boolean constraint over the eligible cells, so Z3 stays in its SAT/PB core.
+   Return the Bool constants in cell_index order, with false for the cells input.eligible rules out.
+   People eligible everywhere visit every room exactly once, the others spread their rows over the rooms they
+   may use, see restricted_visits().
+*/
+Z3_ast *mk_pb_model(Z3_context ctx, Z3_solver solver, const schedule_input input, Arena *arena)
+{
+    Z3_sort bool_sort = Z3_mk_bool_sort(ctx);
+    size_t n_cells = input.n_people * input.row * input.cols_len;
+    size_t widest = input.n_people;
+    if (input.row > widest)
+        widest = input.row;
+    if (input.cols_len > widest)
+        widest = input.cols_len;
+
+    Z3_ast *cells = (Z3_ast *)arena_alloc(arena, sizeof(Z3_ast) * n_cells);
+    Z3_ast *args = (Z3_ast *)arena_alloc(arena, sizeof(Z3_ast) * widest);
+    int *coeffs = (int *)arena_alloc(arena, sizeof(int) * widest);
+    if (cells == NULL || args == NULL || coeffs == NULL)
+        return NULL;
+    for (size_t k = 0; k < widest; k++)
+    {
+        coeffs[k] = 1;
+    }
+
+    const Eligibility *el = input.eligible;
+    char name[64];
+    for (size_t i = 0; i < input.n_people; i++)
+    {
+        for (size_t r = 0; r < input.row; r++)
+        {
+            for (size_t c = 0; c < input.cols_len; c++)
+            {
+                sprintf(name, "x_%zu_%zu_%zu", i, r, c);
+                cells[cell_index(&input, i, r, c)] =
+                    eligible(el, (int)i, r, c) ? mk_var(ctx, name, bool_sort) : Z3_mk_false(ctx);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < input.n_people; i++)
+    {
+        // exactly one room in every row the person is available in
+        for (size_t r = 0; r < input.row; r++)
+        {
+            if (!eligible_section(el, (int)i, r))
+                continue;
+            size_t len = 0;
+            for (size_t c = 0; c < input.cols_len; c++)
+            {
+                if (eligible_room(el, (int)i, c))
+                    args[len++] = cells[cell_index(&input, i, r, c)];
+            }
+            assert_count(ctx, solver, len, args, coeffs, 1, 1);
+        }
+        // every room exactly once, or at most once more after the visited rows
+        int unrestricted = eligibility_unrestricted(el, (int)i);
+        size_t lo = 1, hi = 1;
+        if (!unrestricted)
+            restricted_visits(&input, i, &lo, &hi);
+        for (size_t c = 0; c < input.cols_len; c++)
+        {
+            if (!eligible_room(el, (int)i, c))
+                continue;
+            size_t len = 0;
+            for (size_t r = 0; r < input.row; r++)
+            {
+                if (eligible(el, (int)i, r, c))
+                    args[len++] = cells[cell_index(&input, i, r, c)];
+            }
+            if (input.visited == NULL)
+                assert_count(ctx, solver, len, args, coeffs, lo, hi);
+            else
+                assert_count(ctx, solver, len, args, coeffs, 0, input.visited[i * input.cols_len + c] == 0 ? 1 : 0);
+        }
+    }
+
+    for (size_t r = 0; r < input.row; r++)
+    {
+        for (size_t c = 0; c < input.cols_len; c++)
+        {
+            size_t len = 0;
+            for (size_t i = 0; i < input.n_people; i++)
+            {
+                if (eligible(el, (int)i, r, c))
+                    args[len++] = cells[cell_index(&input, i, r, c)];
+            }
+            assert_count(ctx, solver, len, args, coeffs, input.cols_x[c], input.cols_y[c]);
+        }
+    }
+
+    return cells;
+}
+
+/**
+   \brief Bound the number of cells every pair of people shares by bound.
+
+   When guard is not NULL the bounds only apply while guard holds. Rows in
+   input.co_used count against the bound. Only the cells both people are
+   eligible for are counted, and a pair that cannot exceed its bound gets
+   no term at all.
+*/
+int assert_co_assign(Z3_context ctx, Z3_solver solver, const schedule_input input, const Z3_ast *cells, int bound, Z3_ast guard,
+                     Arena *arena)
+{
+    size_t n = input.row * input.cols_len;
+    Z3_ast *conds = (Z3_ast *)arena_alloc(arena, sizeof(Z3_ast) * n);
+    int *coeffs = (int *)arena_alloc(arena, sizeof(int) * n);
+    if (conds == NULL || coeffs == NULL)
+        return 1;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        coeffs[i] = 1;
+    }
+
+    for (size_t i = 0; i < input.n_people; i++)
+    {
+        for (size_t j = i + 1; j < input.n_people; j++)
+        {
+            size_t len = 0;
+            for (size_t k = 0; k < n; k++)
+            {
+                size_t r = k / input.cols_len, c = k % input.cols_len;
+                if (!eligible(input.eligible, (int)i, r, c) || !eligible(input.eligible, (int)j, r, c))
+                    continue;
+                // ma[r][c] > 0 && mb[r][c] > 0
+                Z3_ast args[] = {cells[i * n + k], cells[j * n + k]};
+                conds[len++] = Z3_mk_and(ctx, 2, args);
+            }
+
+            int left = input.co_used == NULL ? bound : bound - input.co_used[i * input.n_people + j];
+            if (left >= 0 && len <= (size_t)left)
+                continue;
+            Z3_ast le = Z3_mk_pble(ctx, len, conds, coeffs, left);
+            Z3_solver_assert(
+                ctx,
+                solver,
+                guard == NULL ? le : Z3_mk_implies(ctx, guard, le));
+        }
+    }
+
+    return 0;
+}
+
+/**
+   \brief Keep enough people for the rows after input that have not visited each room yet.
+
+   Every one of them visits the room once in the input.rows_after rows still
+   to come, so their number must lie between cols_x and cols_y times that.
+   With input.eligible only the people eligible for every row it covers and
+   every room must do so; those qualified for the room with restrictions may
+   still fill it, so they only count towards the lower bound.
+*/
+int assert_rooms_left(Z3_context ctx, Z3_solver solver, const schedule_input input, const Z3_ast *cells, Arena *arena)
+{
+    size_t n = input.n_people * input.row;
+    Z3_ast *args = (Z3_ast *)arena_alloc(arena, sizeof(Z3_ast) * n);
+    if (args == NULL)
+        return 1;
+
+    const Eligibility *el = input.eligible;
+    for (size_t c = 0; c < input.cols_len; c++)
+    {
+        // the cells of the people bound to visit come first in args
+        size_t unvisited = 0, optional = 0, len = 0, bound_len = 0;
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (size_t i = 0; i < input.n_people; i++)
+            {
+                if (input.visited[i * input.cols_len + c] != 0 || !eligible_room(el, (int)i, c) ||
+                    eligibility_unrestricted(el, (int)i) != (pass == 0))
+                    continue;
+                if (pass == 0)
+                    unvisited++;
+                else
+                    optional++;
+                for (size_t r = 0; r < input.row; r++)
+                {
+                    if (eligible_section(el, (int)i, r))
+                        args[len++] = cells[cell_index(&input, i, r, c)];
+                }
+            }
+            if (pass == 0)
+                bound_len = len;
+        }
+        // unvisited - visits in this input must lie in [x * rows_after, y * rows_after]
+        size_t lo = input.cols_x[c] * input.rows_after, hi = input.cols_y[c] * input.rows_after;
+        if (unvisited + optional < lo)
+        {
+            Z3_solver_assert(ctx, solver, Z3_mk_false(ctx));
+            break;
+        }
+        if (len > 0)
+            Z3_solver_assert(ctx, solver, Z3_mk_atmost(ctx, len, args, unvisited + optional - lo));
+        if (unvisited > hi)
+            Z3_solver_assert(ctx, solver, Z3_mk_atleast(ctx, bound_len, args, unvisited - hi));
+    }
+    return 0;
+}
+
+/**
+   \brief Build u <=lex v over Bool terms, false < true and u[0] the most significant.
+*/
+Z3_ast mk_lex_le(Z3_context ctx, size_t len, const Z3_ast *u, const Z3_ast *v, Arena *arena)
+{
+    Z3_ast prefix_eq = Z3_mk_true(ctx);
+    Z3_ast *conds = (Z3_ast *)arena_alloc(arena, sizeof(Z3_ast) * len);
+    if (conds == NULL)
+        return NULL;
+    for (size_t k = 0; k < len; k++)
+    {
+        // while the prefix is equal u[k] may only be set if v[k] is
+        conds[k] = Z3_mk_implies(ctx, prefix_eq, Z3_mk_implies(ctx, u[k], v[k]));
+        Z3_ast args[] = {prefix_eq, Z3_mk_iff(ctx, u[k], v[k])};
+        prefix_eq = Z3_mk_and(ctx, 2, args);
+    }
+    return Z3_mk_and(ctx, len, conds);
+}
+
+/**
+   \brief Two rooms are interchangeable when they have the same bounds and the same people are eligible for them.
+*/
+int cols_equivalent(const schedule_input *input, size_t a, size_t b)
+{
+    return input->cols_x[a] == input->cols_x[b] && input->cols_y[a] == input->cols_y[b] &&
+           eligibility_same_room(input->eligible, a, b);
+}
+
+/**
+   \brief Break the symmetries of the model with lex-leader constraints.
+
+   People carry no data of their own and every row has the same requirements,
+   so any permutation of people or rows maps a schedule to another one, and so
+   does swapping rooms with equal bounds. With input.eligible this only holds
+   among people, rows and rooms of equal eligibility, so each is chained to
+   the next equivalent one as rooms are. All constraints compare against the
+   same cell_index order, which keeps the lex-smallest member of every orbit.
+*/
+int assert_symmetry_breaking(Z3_context ctx, Z3_solver solver, const schedule_input input, const Z3_ast *cells,
+                             Arena *arena)
+{
+    size_t per_person = input.row * input.cols_len;
+    size_t per_row = input.n_people * input.cols_len;
+    size_t per_col = input.n_people * input.row;
+    size_t widest = per_person;
+    if (per_row > widest)
+        widest = per_row;
+    if (per_col > widest)
+        widest = per_col;
+    Z3_ast *u = (Z3_ast *)arena_alloc(arena, sizeof(Z3_ast) * widest);
+    Z3_ast *v = (Z3_ast *)arena_alloc(arena, sizeof(Z3_ast) * widest);
+    if (u == NULL || v == NULL)
+        return 1;
+
+    // people: cells[i] <=lex cells[j] for the next person j eligible for the same cells
+    for (size_t i = 0; i + 1 < input.n_people; i++)
+    {
+        size_t j = i + 1;
+        while (j < input.n_people && !eligibility_same_staff(input.eligible, (int)i, (int)j))
+            j++;
+        if (j == input.n_people)
+            continue;
+        Z3_ast le = mk_lex_le(ctx, per_person, cells + i * per_person, cells + j * per_person, arena);
+        if (le == NULL)
+            return 1;
+        Z3_solver_assert(ctx, solver, le);
+    }
+
+    // rows: row r <=lex the next row with the same people available, both read in (person, col) order
+    for (size_t r = 0; r + 1 < input.row; r++)
+    {
+        size_t q = r + 1;
+        while (q < input.row && !eligibility_same_section(input.eligible, r, q))
+            q++;
+        if (q == input.row)
+            continue;
+        size_t k = 0;
+        for (size_t i = 0; i < input.n_people; i++)
+        {
+            for (size_t c = 0; c < input.cols_len; c++, k++)
+            {
+                u[k] = cells[cell_index(&input, i, r, c)];
+                v[k] = cells[cell_index(&input, i, q, c)];
+            }
+        }
+        Z3_ast le = mk_lex_le(ctx, per_row, u, v, arena);
+        if (le == NULL)
+            return 1;
+        Z3_solver_assert(ctx, solver, le);
+    }
+
+    // rooms: chain every room to the next equivalent one, read in (person, row) order
+    for (size_t a = 0; a < input.cols_len; a++)
+    {
+        size_t b = a + 1;
+        while (b < input.cols_len && !cols_equivalent(&input, a, b))
+            b++;
+        if (b == input.cols_len)
+            continue;
+        size_t k = 0;
+        for (size_t i = 0; i < input.n_people; i++)
+        {
+            for (size_t r = 0; r < input.row; r++, k++)
+            {
+                u[k] = cells[cell_index(&input, i, r, a)];
+                v[k] = cells[cell_index(&input, i, r, b)];
+            }
+        }
+        Z3_ast le = mk_lex_le(ctx, per_col, u, v, arena);
+        if (le == NULL)
+            return 1;
+        Z3_solver_assert(ctx, solver, le);
+    }
+    return 0;
+}
+
+/**
+   \brief Copy the statistics of the last check into stats.
+*/
+int collect_stats(Z3_context ctx, Z3_solver solver, schedule_stats *stats)
+{
+    Z3_stats st = Z3_solver_get_statistics(ctx, solver);
+    Z3_stats_inc_ref(ctx, st);
+    unsigned n = Z3_stats_size(ctx, st);
+    stats->stat_keys = (char **)calloc(n, sizeof(char *));
+    stats->stat_values = (double *)calloc(n, sizeof(double));
+    if (stats->stat_keys == NULL || stats->stat_values == NULL)
+    {
+        Z3_stats_dec_ref(ctx, st);
+        return 1;
+    }
+    for (unsigned i = 0; i < n; i++)
+    {
+        const char *key = Z3_stats_get_key(ctx, st, i);
+        stats->stat_keys[i] = (char *)malloc(strlen(key) + 1);
+        if (stats->stat_keys[i] == NULL)
+            break;
+        strcpy(stats->stat_keys[i], key);
+        stats->stat_values[i] = Z3_stats_is_uint(ctx, st, i)
+                                    ? (double)Z3_stats_get_uint_value(ctx, st, i)
+                                    : Z3_stats_get_double_value(ctx, st, i);
+        stats->n_stats = i + 1;
+    }
+    Z3_stats_dec_ref(ctx, st);
+    return 0;
+}
+
+/**
+   \brief Add the phase timings and the Z3 statistics in stats to tel.
+*/
+int schedule_stats_telemetry(const schedule_stats *stats, Telemetry *tel)
+{
+    telemetry_phase(tel, PHASE_BUILD, stats->build_seconds);
+    telemetry_phase(tel, PHASE_CHECK, stats->check_seconds);
+    telemetry_phase(tel, PHASE_EXTRACT, stats->extract_seconds);
+    if (stats->hint_seconds > 0 && telemetry_stat(tel, "hint_seconds", stats->hint_seconds) != 0)
+        return 2;
+    for (size_t i = 0; i < stats->n_stats; i++)
+    {
+        if (telemetry_stat(tel, stats->stat_keys[i], stats->stat_values[i]) != 0)
+            return 2;
+    }
+    return 0;
+}
+
+/**
+   \brief Make the solver give up after timeout_ms milliseconds, 0 for no limit.
+*/
+void set_timeout(Z3_context ctx, Z3_solver solver, unsigned timeout_ms)
+{
+    if (timeout_ms == 0)
+        return;
+    Z3_params params = Z3_mk_params(ctx);
+    Z3_params_inc_ref(ctx, params);
+    Z3_params_set_uint(ctx, params, Z3_mk_string_symbol(ctx, "timeout"), timeout_ms);
+    Z3_solver_set_params(ctx, solver, params);
+    Z3_params_dec_ref(ctx, params);
+}
+
+/**
+   \brief Reset result and give its n_people people their printable names.
+*/
+int init_schedule_result(schedule_result *result, size_t n_people)
+{
+    memset(result, 0, sizeof(schedule_result));
+    arena_init(&result->arena, 0);
+    result->names = (char **)arena_alloc(&result->arena, sizeof(char *) * (n_people + 1));
+    if (result->names == NULL)
+        return 1;
+    result->n_names = n_people;
+    for (size_t i = 0; i < n_people; i++)
+    {
+        char name[24];
+        sprintf(name, "P%zu", i);
+        result->names[i] = arena_strdup(&result->arena, name);
+        if (result->names[i] == NULL)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+   \brief Check under the hard assumptions and as many soft ones as possible.
+
+   assumptions holds n_hard hard assumptions followed by n_soft soft ones. Soft
+   assumptions in an unsat core are dropped and the check is repeated until it
+   succeeds or the core has only hard assumptions. The soft assumptions that
+   held are moved to the front of the soft part and counted in *n_kept.
+*/
+Z3_lbool check_soft(Z3_context ctx, Z3_solver solver, Z3_ast *assumptions, size_t n_hard, size_t n_soft, size_t *n_kept)
+{
+    size_t k = n_hard + n_soft;
+    Z3_lbool res;
+    while ((res = Z3_solver_check_assumptions(ctx, solver, k, assumptions)) == Z3_L_FALSE && k > n_hard)
+    {
+        Z3_ast_vector core = Z3_solver_get_unsat_core(ctx, solver);
+        Z3_ast_vector_inc_ref(ctx, core);
+        unsigned core_len = Z3_ast_vector_size(ctx, core);
+        size_t kept = n_hard;
+        for (size_t p = n_hard; p < k; p++)
+        {
+            int in_core = 0;
+            for (unsigned q = 0; q < core_len && !in_core; q++)
+            {
+                in_core = Z3_is_eq_ast(ctx, Z3_ast_vector_get(ctx, core, q), assumptions[p]);
+            }
+            if (!in_core)
+                assumptions[kept++] = assumptions[p];
+        }
+        Z3_ast_vector_dec_ref(ctx, core);
+        // a core made of hard assumptions only: infeasible whatever the soft ones say
+        if (kept == k)
+            break;
+        k = kept;
+    }
+    if (n_kept != NULL)
+        *n_kept = k - n_hard;
+    return res;
+}
+
+/**
+   \brief Assert everything but the co-assignment bound for input into the scope's solver and return the cell terms.
+
+   The cell terms and all scratch memory live in sc->arena.
+*/
+Z3_ast *build_model(schedule_scope *sc, const schedule_input input)
+{
+    Z3_context ctx = sc->ctx;
+    Z3_solver solver = sc->solver;
+    Z3_ast *cells = input.encoding == ENCODING_PB
+                        ? mk_pb_model(ctx, solver, input, &sc->arena)
+                        : mk_int_array_model(ctx, solver, input, &sc->arena);
+    if (cells == NULL)
+        return NULL;
+    if (input.visited != NULL && assert_rooms_left(ctx, solver, input, cells, &sc->arena) != 0)
+        return NULL;
+    // earlier rows tell people and rooms apart
+    int history = input.visited != NULL || input.co_used != NULL;
+    if (input.symmetry_breaking && !history && assert_symmetry_breaking(ctx, solver, input, cells, &sc->arena) != 0)
+        return NULL;
+    return cells;
+}
+
+/**
+   \brief Read the assignment of model into result->entries.
+*/
+int extract_entries(Z3_context ctx, Z3_model model, const schedule_input *input, const Z3_ast *cells, schedule_result *result)
+{
+    // a later model of the same input overwrites the entries of an earlier one
+    schedule_entry *entries = result->entries;
+    if (entries == NULL)
+        entries = (schedule_entry *)arena_alloc(&result->arena, sizeof(schedule_entry) * input->row * input->n_people);
+    if (entries == NULL)
+        return 1;
+    result->entries = entries;
+    size_t entry_cnt = 0;
+    for (size_t i = 0; i < input->n_people; i++)
+    {
+        for (size_t r = 0; r < input->row; r++)
+        {
+            for (size_t c = 0; c < input->cols_len; c++)
+            {
+                Z3_ast out;
+                Z3_lbool success = Z3_model_eval(ctx, model, cells[cell_index(input, i, r, c)], true, &out);
+                if (success != Z3_L_TRUE)
+                    return 2;
+                Z3_lbool assigned = Z3_get_bool_value(ctx, out);
+                if (assigned == Z3_L_UNDEF)
+                    return 3;
+                if (assigned == Z3_L_TRUE)
+                {
+                    entries[entry_cnt].row = r;
+                    entries[entry_cnt].col = c;
+                    entries[entry_cnt].person = i;
+                    entries[entry_cnt].name = result->names[i];
+                    entry_cnt++;
+                }
+            }
+        }
+    }
+    result->entry_cnt = entry_cnt;
+    return 0;
+}
+
+void schedule_interrupt_init(schedule_interrupt *si)
+{
+    pthread_mutex_init(&si->lock, NULL);
+    si->cancelled = 0;
+    si->ctx = NULL;
+}
+
+void schedule_interrupt_destroy(schedule_interrupt *si)
+{
+    pthread_mutex_destroy(&si->lock);
+}
+
+/**
+   \brief Stop the running check, if any, and every later one that uses si.
+*/
+void schedule_interrupt_cancel(schedule_interrupt *si)
+{
+    pthread_mutex_lock(&si->lock);
+    si->cancelled = 1;
+    if (si->ctx != NULL)
+        Z3_interrupt(si->ctx);
+    pthread_mutex_unlock(&si->lock);
+}
+
+/**
+   \brief Register ctx as the context to interrupt, return 1 if si was already cancelled.
+
+   si may be NULL.
+*/
+int schedule_interrupt_enter(schedule_interrupt *si, Z3_context ctx)
+{
+    if (si == NULL)
+        return 0;
+    pthread_mutex_lock(&si->lock);
+    int cancelled = si->cancelled;
+    if (!cancelled)
+        si->ctx = ctx;
+    pthread_mutex_unlock(&si->lock);
+    return cancelled;
+}
+
+/**
+   \brief Forget the registered context before it is deleted.
+*/
+void schedule_interrupt_leave(schedule_interrupt *si)
+{
+    if (si == NULL)
+        return;
+    pthread_mutex_lock(&si->lock);
+    si->ctx = NULL;
+    pthread_mutex_unlock(&si->lock);
+}
+
+/**
+   \brief Build the model of input, solve it and read the assignment into result.
+
+   stats may be NULL.
+*/
+int schedule_run(const schedule_input input, schedule_result *result, schedule_stats *stats)
+{
+    if (stats != NULL)
+        memset(stats, 0, sizeof(schedule_stats));
+    if (init_schedule_result(result, input.n_people) != 0)
+        return 1;
+
+    double start = now_seconds();
+    schedule_scope sc;
+    schedule_scope_open(&sc);
+    sc.solver = mk_solver(sc.ctx);
+    Z3_context ctx = sc.ctx;
+    Z3_solver solver = sc.solver;
+    set_timeout(ctx, solver, input.timeout_ms);
+    int ret = 0;
+    Z3_ast *cells = build_model(&sc, input);
+    if (cells == NULL)
+    {
+        ret = 1;
+        goto done;
+    }
+
+    if (input.max_co_assign > 0 &&
+        assert_co_assign(ctx, solver, input, cells, input.max_co_assign, NULL, &sc.arena) != 0)
+    {
+        ret = 1;
+        goto done;
+    }
+
+    // The context is registered only now: Z3 forgets an interrupt that
+    // arrives before the check starts. A cancelled solve reports unknown
+    // like a timeout.
+    if (schedule_interrupt_enter(input.interrupt, ctx))
+        goto done;
+    double built = now_seconds();
+    Z3_lbool res;
+    if (input.hint != NULL)
+    {
+        // hinted cells are soft assumptions, dropped when they conflict
+        Z3_ast *soft = (Z3_ast *)arena_alloc(&sc.arena, sizeof(Z3_ast) * input.n_people * input.row);
+        if (soft == NULL)
+        {
+            ret = 1;
+            goto done;
+        }
+        size_t n_soft = 0;
+        for (size_t i = 0; i < input.n_people; i++)
+        {
+            for (size_t r = 0; r < input.row; r++)
+            {
+                int c = input.hint[i * input.row + r];
+                if (c != NO_ASSIGN && (size_t)c < input.cols_len)
+                    soft[n_soft++] = cells[cell_index(&input, i, r, c)];
+            }
+        }
+        size_t n_kept;
+        res = check_soft(ctx, solver, soft, 0, n_soft, &n_kept);
+        if (stats != NULL)
+        {
+            stats->hints_total = n_soft;
+            stats->hints_kept = n_kept;
+        }
+    }
+    else
+    {
+        res = Z3_solver_check(ctx, solver);
+    }
+    double checked = now_seconds();
+    result->status = res;
+
+    if (res == Z3_L_TRUE)
+    {
+        ret = extract_entries(ctx, Z3_solver_get_model(ctx, solver), &input, cells, result);
+        if (ret != 0)
+            goto done;
+    }
+
+    if (stats != NULL)
+    {
+        stats->build_seconds = built - start;
+        stats->check_seconds = checked - built;
+        stats->extract_seconds = now_seconds() - checked;
+        if (collect_stats(ctx, solver, stats) != 0)
+            ret = 1;
+    }
+
+done:
+    schedule_interrupt_leave(input.interrupt);
+    schedule_scope_close(&sc);
+    return ret;
+}
+
+void print_schedule(const schedule_input *input, const schedule_result *result)
+{
+    if (result->status != Z3_L_TRUE)
+    {
+        printf(result->status == Z3_L_FALSE ? "unsat\n" : "unknown\n");
+        return;
+    }
+
+    for (size_t r = 0; r < input->row; r++)
+    {
+        for (size_t c = 0; c < input->cols_len; c++)
+        {
+            printf("[");
+            int first = 1;
+            for (size_t i = 0; i < result->entry_cnt; i++)
+            {
+                if (result->entries[i].row == r && result->entries[i].col == c)
+                {
+                    if (first)
+                    {
+                        first = 0;
+                    }
+                    else
+                    {
+                        printf(" ");
+                    }
+                    printf("%s", result->entries[i].name);
+                }
+            }
+            printf("] ");
+        }
+        printf("\n");
+    }
+}
+
+void free_schedule_result(schedule_result *result)
+{
+    arena_free(&result->arena);
+    result->names = NULL;
+    result->entries = NULL;
+    result->entry_cnt = 0;
+}
+
+void free_schedule_stats(schedule_stats *stats)
+{
+    for (size_t i = 0; i < stats->n_stats; i++)
+    {
+        free(stats->stat_keys[i]);
+    }
+    free(stats->stat_keys);
+    free(stats->stat_values);
+}
+
+int schedule(const schedule_input input)
+{
+    schedule_result result;
+    int ret = schedule_run(input, &result, NULL);
+    if (ret == 0)
+        print_schedule(&input, &result);
+    free_schedule_result(&result);
+    return ret;
+}
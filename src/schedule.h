@@ -0,0 +1,261 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <z3.h>
+
+#include "anneal.h"
+
+// #define LOG_Z3_CALLS
+
+#ifdef LOG_Z3_CALLS
+#define LOG_MSG(msg) Z3_append_log(msg)
+#else
+#define LOG_MSG(msg) ((void)0)
+#endif
+
+typedef enum _schedule_encoding_
+{
+    /// m[person][row][col] as nested Int arrays
+    ENCODING_INT_ARRAY,
+    /// one Bool per (person, row, col) with pseudo-Boolean constraints
+    ENCODING_PB,
+} schedule_encoding;
+
+/// Lets another thread stop a solve, see schedule_interrupt_cancel().
+typedef struct _schedule_interrupt_
+{
+    pthread_mutex_t lock;
+    /// set once by schedule_interrupt_cancel, polled by the annealer
+    volatile int cancelled;
+    /// the context of the running Z3 check, NULL when there is none
+    Z3_context ctx;
+} schedule_interrupt;
+
+typedef struct _schedule_input_
+{
+    size_t row;
+    /// (min, max) of human resource requirement for every room
+    size_t *cols_x, *cols_y;
+    size_t cols_len;
+    size_t n_people;
+    int max_co_assign;
+    schedule_encoding encoding;
+    /// add lex-leader constraints for interchangeable people, rows and rooms
+    int symmetry_breaking;
+    /// give up after this many milliseconds, 0 for no limit
+    unsigned timeout_ms;
+    /// optional room of person i in row r at hint[i * row + r], or NO_ASSIGN;
+    /// hinted cells are tried first and given up where they conflict
+    const int *hint;
+    /// optional, lets another thread interrupt the check
+    schedule_interrupt *interrupt;
+    /// optional history of rows solved before this input, see rolling.c:
+    /// visited[i * cols_len + c] counts the earlier rows that put person i in
+    /// room c, and every room is then visited at most once more
+    const size_t *visited;
+    /// optional co_used[i * n_people + j] counts the earlier rows in which
+    /// people i and j shared a room, it is taken off max_co_assign;
+    /// symmetry_breaking is ignored when either history is given
+    const int *co_used;
+    /// rows still to be solved after this input, only used with visited
+    size_t rows_after;
+    /// optional rows and rooms every person may be assigned to, with staffs as people,
+    /// sections as rows and rooms as cols; it may cover rows after the input, which
+    /// assert_rooms_left reads. No cell is made for an ineligible assignment.
+    const Eligibility *eligible;
+} schedule_input;
+
+/// Z3 context, solver and memory of one solve, released together by schedule_scope_close().
+typedef struct _schedule_scope_
+{
+    Z3_context ctx;
+    /// set by the owner, e.g. with mk_solver()
+    Z3_solver solver;
+    /// cell terms and scratch of the model builders
+    Arena arena;
+} schedule_scope;
+
+typedef struct _schedule_entry_
+{
+    size_t row;
+    size_t col;
+    size_t person;
+    char *name;
+} schedule_entry;
+
+typedef struct _schedule_result_
+{
+    /// Z3_L_TRUE with entries filled in, Z3_L_FALSE for unsat, Z3_L_UNDEF on timeout
+    Z3_lbool status;
+    schedule_entry *entries;
+    size_t entry_cnt;
+    /// names[i] is the name of person i, entries point into it
+    char **names;
+    size_t n_names;
+    /// holds names and entries, freed by free_schedule_result
+    Arena arena;
+} schedule_result;
+
+/// Wall-clock time of every phase and the statistics Z3 reports for the check.
+typedef struct _schedule_stats_
+{
+    /// time spent computing input.hint, set by schedule_hybrid
+    double hint_seconds;
+    double build_seconds;
+    double check_seconds;
+    double extract_seconds;
+    /// hinted cells passed to the solver and those the solution kept
+    size_t hints_total;
+    size_t hints_kept;
+    /// checks run by schedule_min_co_assign
+    size_t co_probes;
+    /// windows solved by schedule_rolling
+    size_t windows;
+    size_t n_stats;
+    char **stat_keys;
+    double *stat_values;
+} schedule_stats;
+
+
+typedef struct _lns_config_
+{
+    /// consecutive sections freed by a repair
+    size_t window;
+    /// staffs freed in those sections, the others keep their rooms; 0 frees everyone
+    size_t n_free;
+    /// bound on every repair's optimisation, 0 for no limit
+    unsigned timeout_ms;
+    uint64_t seed;
+} lns_config;
+
+typedef struct _lns_stats_
+{
+    size_t repairs;
+    /// repairs that lowered the energy, and by how much in total
+    size_t improved;
+    size_t gain;
+    double seconds;
+} lns_stats;
+
+/// Z3 repair operator of anneal_lns, see lns.c.
+typedef struct _lns_repair_
+{
+    schedule_scope sc;
+    Z3_optimize opt;
+    lns_config cfg;
+    size_t n_secs, n_rooms, n_staffs;
+    const size_t *history;
+    const Eligibility *eligible;
+    /// one Bool per (section of the window, staff, room), row major, false for rooms the staff is not qualified for
+    Z3_ast *cells;
+    /// steps[(s * n_rooms + k) * window + j] holds when staff s sits in room k more than j times in the window
+    Z3_ast *steps;
+    /// visits outside the window, and the staffs of the current repair
+    size_t *outside;
+    int *order;
+    Z3_ast *scratch;
+    int *coeffs;
+    Rng rng;
+    lns_stats stats;
+} lns_repair;
+
+/// Long-lived solver for a schedule that is edited between solves, see session.c.
+typedef struct _schedule_session_
+{
+    Z3_context ctx;
+    Z3_solver solver;
+    size_t row;
+    size_t cols_len;
+    size_t n_people;
+    int max_co_assign;
+    size_t *cols_x, *cols_y;
+    Z3_ast *bound_lit;
+    Z3_ast *active;
+    int *available;
+    Z3_ast shape_lit;
+    /// one Bool per (row, person, col), row major
+    Z3_ast *cells;
+    /// value of every cell in the last solution, -1 before the cell was solved
+    int *prev;
+    size_t cells_cap;
+    Z3_ast *scratch;
+    int *ones;
+    size_t scratch_cap;
+    size_t n_lits;
+    int solved;
+} schedule_session;
+
+void exitf(const char *message);
+void unreachable();
+void error_handler(Z3_context c, Z3_error_code e);
+void throw_z3_error(Z3_context c, Z3_error_code e);
+void nothrow_z3_error(Z3_context c, Z3_error_code e);
+Z3_context mk_context_custom(Z3_config cfg, Z3_error_handler err);
+Z3_solver mk_solver(Z3_context ctx);
+void del_solver(Z3_context ctx, Z3_solver s);
+Z3_context mk_context();
+Z3_context mk_proof_context();
+void schedule_scope_open(schedule_scope *sc);
+void schedule_scope_close(schedule_scope *sc);
+Z3_ast mk_var(Z3_context ctx, const char *name, Z3_sort ty);
+
+size_t cell_index(const schedule_input *input, size_t i, size_t r, size_t c);
+Z3_ast *mk_int_array_model(Z3_context ctx, Z3_solver solver, const schedule_input input, Arena *arena);
+Z3_ast *mk_pb_model(Z3_context ctx, Z3_solver solver, const schedule_input input, Arena *arena);
+int assert_co_assign(Z3_context ctx, Z3_solver solver, const schedule_input input, const Z3_ast *cells, int bound, Z3_ast guard,
+                     Arena *arena);
+int assert_rooms_left(Z3_context ctx, Z3_solver solver, const schedule_input input, const Z3_ast *cells, Arena *arena);
+Z3_ast mk_lex_le(Z3_context ctx, size_t len, const Z3_ast *u, const Z3_ast *v, Arena *arena);
+int cols_equivalent(const schedule_input *input, size_t a, size_t b);
+int assert_symmetry_breaking(Z3_context ctx, Z3_solver solver, const schedule_input input, const Z3_ast *cells,
+                             Arena *arena);
+
+void set_timeout(Z3_context ctx, Z3_solver solver, unsigned timeout_ms);
+int init_schedule_result(schedule_result *result, size_t n_people);
+Z3_lbool check_soft(Z3_context ctx, Z3_solver solver, Z3_ast *assumptions, size_t n_hard, size_t n_soft, size_t *n_kept);
+Z3_ast *build_model(schedule_scope *sc, const schedule_input input);
+int collect_stats(Z3_context ctx, Z3_solver solver, schedule_stats *stats);
+int schedule_stats_telemetry(const schedule_stats *stats, Telemetry *tel);
+int extract_entries(Z3_context ctx, Z3_model model, const schedule_input *input, const Z3_ast *cells, schedule_result *result);
+void schedule_interrupt_init(schedule_interrupt *si);
+void schedule_interrupt_destroy(schedule_interrupt *si);
+void schedule_interrupt_cancel(schedule_interrupt *si);
+int schedule_interrupt_enter(schedule_interrupt *si, Z3_context ctx);
+void schedule_interrupt_leave(schedule_interrupt *si);
+int schedule_run(const schedule_input input, schedule_result *result, schedule_stats *stats);
+void print_schedule(const schedule_input *input, const schedule_result *result);
+void free_schedule_result(schedule_result *result);
+void free_schedule_stats(schedule_stats *stats);
+int schedule(const schedule_input input);
+
+int max_pair_overlap(const schedule_input *input, const schedule_result *result);
+int schedule_min_co_assign(const schedule_input input, schedule_result *result, int *best, schedule_stats *stats);
+
+Z3_solver mk_portfolio_solver(Z3_context ctx, const schedule_input *input, size_t id);
+int schedule_portfolio(const schedule_input input, size_t n_workers, schedule_result *result, int *winner, schedule_stats *stats);
+
+int schedule_rolling(const schedule_input input, size_t window, size_t overlap, schedule_result *result, schedule_stats *stats);
+
+void lns_default_config(lns_config *cfg);
+int lns_init(lns_repair *lr, const Timetable *tt, const size_t *history, const Eligibility *eligible,
+             const lns_config *cfg);
+void lns_free(lns_repair *lr);
+int lns_repair_step(Timetable *tt, const Room *rooms, void *user);
+int anneal_lns(Timetable *tt, const Room *rooms, Rng *rng, const AnnealConfig *cfg, const lns_config *lns, AnnealStats *stats,
+               lns_stats *out);
+
+Room *input_rooms(const schedule_input *input, Arena *arena);
+int heuristic_hint(const schedule_input *input, uint64_t seed, int *hint);
+int schedule_hybrid(const schedule_input input, uint64_t seed, schedule_result *result, schedule_stats *stats);
+
+int schedule_session_open(schedule_session *s, const schedule_input *input);
+void schedule_session_set_available(schedule_session *s, size_t person, int available);
+void schedule_session_set_bounds(schedule_session *s, size_t col, size_t x, size_t y);
+int schedule_session_add_row(schedule_session *s);
+int schedule_session_solve(schedule_session *s, schedule_result *result);
+void schedule_session_close(schedule_session *s);
+
+#endif
@@ -0,0 +1,349 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <z3.h>
+
+#include "anneal.h"
+#include "bitset.h"
+#include "schedule.h"
+#include "scheduler.h"
+
+// scheduler.h on top of the two engines. The annealer reports through
+// AnnealConfig.on_best and polls the token's cancel flag; the Z3 check is
+// stopped through the token's schedule_interrupt. Every schedule found is
+// kept in the caller's solution in the layout of Timetable.room_of.
+
+struct _scheduler_token_
+{
+    schedule_interrupt interrupt;
+};
+
+typedef struct _scheduler_run_
+{
+    const scheduler_instance *inst;
+    const scheduler_options *opts;
+    scheduler_solution *best;
+    /// room capacities as the annealer sees them
+    Room *rooms;
+    double start;
+} scheduler_run;
+
+double scheduler_now()
+{
+    return now_seconds();
+}
+
+void scheduler_default_options(scheduler_options *opts)
+{
+    opts->engine = SCHEDULER_HYBRID;
+    opts->deadline = 0;
+    opts->on_improve = NULL;
+    opts->user = NULL;
+    opts->token = NULL;
+    opts->seed = 1;
+    opts->pb_encoding = 1;
+    opts->symmetry_breaking = 0;
+}
+
+scheduler_token *scheduler_token_new()
+{
+    scheduler_token *token = (scheduler_token *)malloc(sizeof(scheduler_token));
+    if (token != NULL)
+        schedule_interrupt_init(&token->interrupt);
+    return token;
+}
+
+void scheduler_token_free(scheduler_token *token)
+{
+    if (token == NULL)
+        return;
+    schedule_interrupt_destroy(&token->interrupt);
+    free(token);
+}
+
+void scheduler_cancel(scheduler_token *token)
+{
+    schedule_interrupt_cancel(&token->interrupt);
+}
+
+void scheduler_solution_free(scheduler_solution *sol)
+{
+    free(sol->room_of);
+    sol->room_of = NULL;
+}
+
+int scheduler_cancelled(const scheduler_run *run)
+{
+    return run->opts->token != NULL && run->opts->token->interrupt.cancelled;
+}
+
+// seconds left until the deadline, a negative value when there is none
+double scheduler_remaining(const scheduler_run *run)
+{
+    if (run->opts->deadline <= 0)
+        return -1;
+    double left = run->opts->deadline - now_seconds();
+    return left > 0 ? left : 0;
+}
+
+void scheduler_report(scheduler_run *run, const int *room_of, size_t energy, scheduler_status status)
+{
+    scheduler_solution *best = run->best;
+    memcpy(best->room_of, room_of, sizeof(int) * best->n_rows * best->n_people);
+    best->energy = energy;
+    best->status = status;
+    best->seconds = now_seconds() - run->start;
+    if (run->opts->on_improve != NULL)
+        run->opts->on_improve(best, run->opts->user);
+}
+
+void scheduler_anneal_best(const Timetable *tt, size_t energy, void *user)
+{
+    scheduler_report((scheduler_run *)user, tt->room_of, energy, SCHEDULER_HEURISTIC);
+}
+
+/**
+   \brief Build a greedy schedule and anneal it for at most time_limit seconds (0 for no limit).
+
+   Return 1 when there are fewer than two rooms to move people between.
+*/
+int scheduler_anneal(scheduler_run *run, double time_limit)
+{
+    const scheduler_instance *inst = run->inst;
+    if (inst->n_rooms < 2)
+        return 1;
+
+    Timetable tt;
+    int ret = solve(run->rooms, inst->n_rooms, inst->n_rows, inst->n_people, &tt);
+    if (ret != 0)
+        return ret;
+    scheduler_report(run, tt.room_of, energy2(&tt, run->rooms), SCHEDULER_HEURISTIC);
+
+    AnnealConfig cfg;
+    anneal_default_config(&cfg);
+    cfg.time_limit = time_limit;
+    cfg.cancel = run->opts->token != NULL ? &run->opts->token->interrupt.cancelled : NULL;
+    cfg.on_best = scheduler_anneal_best;
+    cfg.user = run;
+    Rng rng;
+    rng_seed(&rng, run->opts->seed);
+    ret = simulated_annealing(&tt, run->rooms, &rng, &cfg, NULL);
+
+    timetable_free(&tt);
+    return ret;
+}
+
+/**
+   \brief Set *ok when room_of seats everyone within the room bounds and max_co_assign.
+*/
+int scheduler_meets_constraints(const scheduler_run *run, const int *room_of, int *ok)
+{
+    const scheduler_instance *inst = run->inst;
+    size_t *size = (size_t *)malloc(sizeof(size_t) * inst->n_rooms);
+    if (size == NULL)
+        return 2;
+    *ok = 1;
+    for (size_t r = 0; r < inst->n_rows && *ok; r++)
+    {
+        memset(size, 0, sizeof(size_t) * inst->n_rooms);
+        for (size_t i = 0; i < inst->n_people && *ok; i++)
+        {
+            int c = room_of[r * inst->n_people + i];
+            if (c == NO_ASSIGN)
+                *ok = 0;
+            else
+                size[c]++;
+        }
+        for (size_t c = 0; c < inst->n_rooms && *ok; c++)
+        {
+            if (size[c] > inst->max_size[c] || (inst->min_size != NULL && size[c] < inst->min_size[c]))
+                *ok = 0;
+        }
+    }
+    free(size);
+    if (!*ok || inst->max_co_assign <= 0)
+        return 0;
+    VisitBits vb;
+    int ret = visit_bits_init(&vb, room_of, inst->n_rows, inst->n_rooms, inst->n_people);
+    if (ret == 0)
+        *ok = visit_bits_co_violations(&vb, (size_t)inst->max_co_assign) == 0;
+    visit_bits_free(&vb);
+    return ret != 0 ? 2 : 0;
+}
+
+/**
+   \brief Solve with Z3, seeded with the best schedule so far when there is one.
+
+   The model only replaces that schedule when it has lower energy or the
+   schedule breaks a constraint; an annealed schedule that meets them all
+   is marked SCHEDULER_FEASIBLE instead.
+*/
+int scheduler_z3(scheduler_run *run)
+{
+    const scheduler_instance *inst = run->inst;
+    size_t *lo = (size_t *)calloc(inst->n_rooms, sizeof(size_t));
+    int *hint = (int *)malloc(sizeof(int) * inst->n_rows * inst->n_people);
+    if (lo == NULL || hint == NULL)
+    {
+        free(lo);
+        free(hint);
+        return 2;
+    }
+    if (inst->min_size != NULL)
+        memcpy(lo, inst->min_size, sizeof(size_t) * inst->n_rooms);
+
+    schedule_input input;
+    input.row = inst->n_rows;
+    input.cols_len = inst->n_rooms;
+    input.cols_x = lo;
+    input.cols_y = (size_t *)inst->max_size;
+    input.n_people = inst->n_people;
+    input.max_co_assign = inst->max_co_assign;
+    input.encoding = run->opts->pb_encoding ? ENCODING_PB : ENCODING_INT_ARRAY;
+    input.symmetry_breaking = run->opts->symmetry_breaking;
+    double left = scheduler_remaining(run);
+    input.timeout_ms = left < 0 ? 0 : (unsigned)(left * 1000) + 1;
+    input.hint = NULL;
+    input.interrupt = run->opts->token != NULL ? &run->opts->token->interrupt : NULL;
+    input.visited = NULL;
+    input.co_used = NULL;
+    input.rows_after = 0;
+    input.eligible = NULL;
+    if (run->best->status != SCHEDULER_NONE)
+    {
+        for (size_t i = 0; i < inst->n_people; i++)
+        {
+            for (size_t r = 0; r < inst->n_rows; r++)
+            {
+                hint[i * inst->n_rows + r] = run->best->room_of[r * inst->n_people + i];
+            }
+        }
+        input.hint = hint;
+    }
+
+    schedule_result result;
+    int ret = schedule_run(input, &result, NULL);
+    if (ret == 0 && result.status == Z3_L_FALSE)
+        run->best->infeasible = 1;
+    if (ret == 0 && result.status == Z3_L_TRUE)
+    {
+        // score the model like the annealer's schedules
+        size_t cap = 0;
+        for (size_t c = 0; c < inst->n_rooms; c++)
+        {
+            if (inst->max_size[c] > cap)
+                cap = inst->max_size[c];
+        }
+        Timetable tt;
+        if (timetable_init(&tt, inst->n_rows, inst->n_rooms, inst->n_people, cap) != 0)
+        {
+            timetable_free(&tt);
+            ret = 2;
+        }
+        else
+        {
+            for (size_t e = 0; e < result.entry_cnt; e++)
+            {
+                assign(&tt, result.entries[e].row, result.entries[e].col, result.entries[e].person);
+            }
+            size_t energy = energy2(&tt, run->rooms);
+            int ok = 0;
+            if (run->best->status == SCHEDULER_HEURISTIC && energy >= run->best->energy)
+                ret = scheduler_meets_constraints(run, run->best->room_of, &ok);
+            if (ret == 0 && ok)
+                run->best->status = SCHEDULER_FEASIBLE;
+            else if (ret == 0)
+                scheduler_report(run, tt.room_of, energy, SCHEDULER_FEASIBLE);
+            timetable_free(&tt);
+        }
+    }
+
+    free_schedule_result(&result);
+    free(lo);
+    free(hint);
+    return ret;
+}
+
+/**
+   \brief Solve inst with opts->engine until it finishes, the deadline passes or the token is cancelled.
+
+   best receives the best schedule found and must be released with
+   scheduler_solution_free. When the rooms cannot hold everyone, or their
+   lower bounds need more people than there are, best->infeasible is set
+   under every engine and nothing is solved. Return 1 for a malformed
+   instance, or under SCHEDULER_ANNEAL one with a single room
+   (SCHEDULER_HYBRID then goes straight to Z3), and 2 when memory runs out.
+*/
+int scheduler_solve(const scheduler_instance *inst, const scheduler_options *opts, scheduler_solution *best)
+{
+    memset(best, 0, sizeof(scheduler_solution));
+    if (inst->n_rows == 0 || inst->n_rooms == 0 || inst->n_people == 0 || inst->max_size == NULL)
+        return 1;
+
+    scheduler_run run;
+    run.inst = inst;
+    run.opts = opts;
+    run.best = best;
+    run.start = now_seconds();
+    best->n_rows = inst->n_rows;
+    best->n_people = inst->n_people;
+    best->status = SCHEDULER_NONE;
+    best->energy = SIZE_MAX;
+    best->room_of = (int *)malloc(sizeof(int) * inst->n_rows * inst->n_people);
+    run.rooms = (Room *)malloc(sizeof(Room) * inst->n_rooms);
+    if (best->room_of == NULL || run.rooms == NULL)
+    {
+        scheduler_solution_free(best);
+        free(run.rooms);
+        return 2;
+    }
+    for (size_t k = 0; k < inst->n_rows * inst->n_people; k++)
+    {
+        best->room_of[k] = NO_ASSIGN;
+    }
+    size_t total = 0, needed = 0;
+    for (size_t c = 0; c < inst->n_rooms; c++)
+    {
+        run.rooms[c].name = NULL;
+        run.rooms[c].cap = inst->max_size[c] < inst->n_people ? (int)inst->max_size[c] : (int)inst->n_people;
+        total += run.rooms[c].cap;
+        needed += inst->min_size != NULL ? inst->min_size[c] : 0;
+    }
+    // every row seats everyone, so the counts alone can rule the instance out
+    if (total < inst->n_people || needed > inst->n_people)
+    {
+        best->infeasible = 1;
+        free(run.rooms);
+        return 0;
+    }
+
+    int ret = 0;
+    if (opts->engine != SCHEDULER_Z3)
+    {
+        // under the hybrid engine the annealer gets half of the budget
+        double left = scheduler_remaining(&run);
+        double limit = left < 0 ? 0 : opts->engine == SCHEDULER_HYBRID ? left / 2 : left;
+        if (left != 0)
+            ret = scheduler_anneal(&run, limit);
+        if (ret == 1 && opts->engine == SCHEDULER_HYBRID)
+            ret = 0;
+    }
+    if (ret == 0 && opts->engine != SCHEDULER_ANNEAL && !scheduler_cancelled(&run) && scheduler_remaining(&run) != 0)
+        ret = scheduler_z3(&run);
+    if (ret == 0 && best->status != SCHEDULER_NONE)
+    {
+        // heuristic schedules are not bound by max_co_assign, so check them
+        VisitBits vb;
+        if (visit_bits_init(&vb, best->room_of, inst->n_rows, inst->n_rooms, inst->n_people) != 0)
+            ret = 2;
+        else
+        {
+            best->max_overlap = visit_bits_max_overlap(&vb, NULL, NULL);
+            best->co_violated = inst->max_co_assign > 0 && best->max_overlap > (size_t)inst->max_co_assign;
+        }
+        visit_bits_free(&vb);
+    }
+
+    free(run.rooms);
+    return ret;
+}
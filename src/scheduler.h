@@ -0,0 +1,95 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Embeddable front end for both engines. A caller describes an instance,
+// picks an engine and a deadline, and gets every improving schedule through
+// a callback while the solve runs, then the best one when it returns.
+// Nothing in this header depends on Z3 or on the annealer's types.
+
+typedef enum _scheduler_engine_
+{
+    /// greedy construction and simulated annealing only
+    SCHEDULER_ANNEAL,
+    /// Z3 only
+    SCHEDULER_Z3,
+    /// the annealer first, then Z3 seeded with its schedule
+    SCHEDULER_HYBRID,
+} scheduler_engine;
+
+typedef enum _scheduler_status_
+{
+    /// nothing found yet
+    SCHEDULER_NONE,
+    /// from the annealer, room bounds and co-assignment limits are not guaranteed
+    SCHEDULER_HEURISTIC,
+    /// meets every constraint of the instance: from Z3, or annealed and checked
+    /// once Z3 found nothing better
+    SCHEDULER_FEASIBLE,
+} scheduler_status;
+
+typedef struct _scheduler_instance_
+{
+    /// sections, every person is placed once in each
+    size_t n_rows;
+    size_t n_rooms;
+    size_t n_people;
+    /// lower and upper bound on the people in every room, n_rooms entries each
+    const size_t *min_size;
+    const size_t *max_size;
+    /// most sections any two people may share a room in, 0 for no limit
+    int max_co_assign;
+} scheduler_instance;
+
+typedef struct _scheduler_solution_
+{
+    scheduler_status status;
+    /// set when no schedule meets the constraints: the room bounds cannot seat
+    /// everyone (found by every engine) or Z3 proved it
+    int infeasible;
+    /// room_of[r * n_people + i] is the room of person i in section r
+    int *room_of;
+    size_t n_rows;
+    size_t n_people;
+    /// energy2 of the schedule, lower is better
+    size_t energy;
+    /// most sections any two people share a room in, set when scheduler_solve returns
+    size_t max_overlap;
+    /// max_overlap is above the instance's max_co_assign, only possible for SCHEDULER_HEURISTIC
+    int co_violated;
+    /// seconds from the start of the solve until it was found
+    double seconds;
+} scheduler_solution;
+
+/// Called with every new best schedule. best is only valid during the call.
+typedef void (*scheduler_callback)(const scheduler_solution *best, void *user);
+
+/// Cancels a solve from any thread, see scheduler_cancel().
+typedef struct _scheduler_token_ scheduler_token;
+
+typedef struct _scheduler_options_
+{
+    scheduler_engine engine;
+    /// stop at this scheduler_now() time, 0 for no deadline
+    double deadline;
+    scheduler_callback on_improve;
+    void *user;
+    /// optional
+    scheduler_token *token;
+    uint64_t seed;
+    /// Z3 model options, see schedule_input
+    int pb_encoding;
+    int symmetry_breaking;
+} scheduler_options;
+
+double scheduler_now();
+void scheduler_default_options(scheduler_options *opts);
+scheduler_token *scheduler_token_new();
+void scheduler_token_free(scheduler_token *token);
+void scheduler_cancel(scheduler_token *token);
+void scheduler_solution_free(scheduler_solution *sol);
+int scheduler_solve(const scheduler_instance *inst, const scheduler_options *opts, scheduler_solution *best);
+
+#endif
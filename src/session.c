@@ -0,0 +1,359 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <z3.h>
+
+#include "schedule.h"
+
+// A schedule_session keeps one context and solver alive across edits. The
+// model uses the pseudo-Boolean encoding, but cells are laid out row major
+// so that adding a row only appends variables. Every editable part of the
+// model is guarded by a literal:
+//
+//   active[i]     person i takes part; when false all of its cells are false
+//   bound_lit[c]  the current (cols_x[c], cols_y[c]) bounds of room c
+//   shape_lit     the constraints that span all rows (every person visits
+//                 every room row / cols or row / cols rounded up times, so
+//                 exactly once while there are as many rows as rooms; the
+//                 co-assignment bound)
+//
+// solve() passes the current literals as assumptions. Guards that an edit
+// replaces are asserted false, so Z3 can drop what they guarded.
+
+size_t session_cell(const schedule_session *s, size_t i, size_t r, size_t c)
+{
+    return (r * s->n_people + i) * s->cols_len + c;
+}
+
+Z3_ast mk_fresh_lit(schedule_session *s, const char *prefix)
+{
+    char name[64];
+    sprintf(name, "%s!%zu", prefix, s->n_lits++);
+    return mk_var(s->ctx, name, Z3_mk_bool_sort(s->ctx));
+}
+
+void assert_guarded(schedule_session *s, Z3_ast guard, Z3_ast fml)
+{
+    Z3_solver_assert(s->ctx, s->solver, Z3_mk_implies(s->ctx, guard, fml));
+}
+
+int session_grow_cells(schedule_session *s, size_t rows)
+{
+    size_t n = rows * s->n_people * s->cols_len;
+    if (n <= s->cells_cap)
+        return 0;
+    size_t cap = s->cells_cap == 0 ? n : s->cells_cap;
+    while (cap < n)
+        cap *= 2;
+    Z3_ast *cells = (Z3_ast *)realloc(s->cells, sizeof(Z3_ast) * cap);
+    int *prev = (int *)realloc(s->prev, sizeof(int) * cap);
+    if (cells != NULL)
+        s->cells = cells;
+    if (prev != NULL)
+        s->prev = prev;
+    if (cells == NULL || prev == NULL)
+        return 1;
+    s->cells_cap = cap;
+    return 0;
+}
+
+/**
+   \brief Assert the constraints that only involve row r.
+*/
+void session_add_row_constraints(schedule_session *s, size_t r)
+{
+    Z3_context ctx = s->ctx;
+    Z3_sort bool_sort = Z3_mk_bool_sort(ctx);
+    char name[64];
+    for (size_t i = 0; i < s->n_people; i++)
+    {
+        for (size_t c = 0; c < s->cols_len; c++)
+        {
+            sprintf(name, "x_%zu_%zu_%zu", i, r, c);
+            s->cells[session_cell(s, i, r, c)] = mk_var(ctx, name, bool_sort);
+            s->prev[session_cell(s, i, r, c)] = -1;
+        }
+        Z3_ast *row = s->cells + session_cell(s, i, r, 0);
+        assert_guarded(s, s->active[i], Z3_mk_pbeq(ctx, s->cols_len, row, s->ones, 1));
+        assert_guarded(s, Z3_mk_not(ctx, s->active[i]), Z3_mk_atmost(ctx, s->cols_len, row, 0));
+    }
+
+    for (size_t c = 0; c < s->cols_len; c++)
+    {
+        for (size_t i = 0; i < s->n_people; i++)
+        {
+            s->scratch[i] = s->cells[session_cell(s, i, r, c)];
+        }
+        Z3_ast args[] = {
+            Z3_mk_atleast(ctx, s->n_people, s->scratch, s->cols_x[c]),
+            Z3_mk_atmost(ctx, s->n_people, s->scratch, s->cols_y[c]),
+        };
+        assert_guarded(s, s->bound_lit[c], Z3_mk_and(ctx, 2, args));
+    }
+}
+
+/**
+   \brief Retire the current shape literal and assert the row-spanning constraints under a new one.
+*/
+void session_add_shape_constraints(schedule_session *s)
+{
+    Z3_context ctx = s->ctx;
+    if (s->shape_lit != NULL)
+        Z3_solver_assert(ctx, s->solver, Z3_mk_not(ctx, s->shape_lit));
+    s->shape_lit = mk_fresh_lit(s, "shape");
+
+    // a person sits once per row, so the visits are spread as evenly as the rows allow
+    unsigned lo = s->row / s->cols_len, hi = (s->row + s->cols_len - 1) / s->cols_len;
+    for (size_t i = 0; i < s->n_people; i++)
+    {
+        for (size_t c = 0; c < s->cols_len; c++)
+        {
+            for (size_t r = 0; r < s->row; r++)
+            {
+                s->scratch[r] = s->cells[session_cell(s, i, r, c)];
+            }
+            Z3_ast guard_args[] = {s->shape_lit, s->active[i]};
+            Z3_ast guard = Z3_mk_and(ctx, 2, guard_args);
+            if (lo == hi)
+            {
+                assert_guarded(s, guard, Z3_mk_pbeq(ctx, s->row, s->scratch, s->ones, lo));
+                continue;
+            }
+            Z3_ast args[] = {
+                Z3_mk_atleast(ctx, s->row, s->scratch, lo),
+                Z3_mk_atmost(ctx, s->row, s->scratch, hi),
+            };
+            assert_guarded(s, guard, Z3_mk_and(ctx, 2, args));
+        }
+    }
+
+    if (s->max_co_assign <= 0)
+        return;
+    size_t n = s->row * s->cols_len;
+    for (size_t i = 0; i < s->n_people; i++)
+    {
+        for (size_t j = i + 1; j < s->n_people; j++)
+        {
+            size_t k = 0;
+            for (size_t r = 0; r < s->row; r++)
+            {
+                for (size_t c = 0; c < s->cols_len; c++, k++)
+                {
+                    Z3_ast args[] = {s->cells[session_cell(s, i, r, c)], s->cells[session_cell(s, j, r, c)]};
+                    s->scratch[k] = Z3_mk_and(ctx, 2, args);
+                }
+            }
+            assert_guarded(s, s->shape_lit, Z3_mk_pble(ctx, n, s->scratch, s->ones, s->max_co_assign));
+        }
+    }
+}
+
+int session_grow_scratch(schedule_session *s, size_t rows)
+{
+    size_t n = rows * s->cols_len;
+    if (s->n_people > n)
+        n = s->n_people;
+    if (n <= s->scratch_cap)
+        return 0;
+    Z3_ast *scratch = (Z3_ast *)realloc(s->scratch, sizeof(Z3_ast) * n);
+    int *ones = (int *)realloc(s->ones, sizeof(int) * n);
+    if (scratch != NULL)
+        s->scratch = scratch;
+    if (ones != NULL)
+        s->ones = ones;
+    if (scratch == NULL || ones == NULL)
+        return 1;
+    for (size_t k = s->scratch_cap; k < n; k++)
+    {
+        s->ones[k] = 1;
+    }
+    s->scratch_cap = n;
+    return 0;
+}
+
+/**
+   \brief Create a session for input. input.encoding and input.symmetry_breaking are ignored.
+*/
+int schedule_session_open(schedule_session *s, const schedule_input *input)
+{
+    memset(s, 0, sizeof(schedule_session));
+    s->ctx = mk_context();
+    s->solver = mk_solver(s->ctx);
+    set_timeout(s->ctx, s->solver, input->timeout_ms);
+    s->row = input->row;
+    s->cols_len = input->cols_len;
+    s->n_people = input->n_people;
+    s->max_co_assign = input->max_co_assign;
+
+    s->cols_x = (size_t *)malloc(sizeof(size_t) * s->cols_len);
+    s->cols_y = (size_t *)malloc(sizeof(size_t) * s->cols_len);
+    s->bound_lit = (Z3_ast *)malloc(sizeof(Z3_ast) * s->cols_len);
+    s->active = (Z3_ast *)malloc(sizeof(Z3_ast) * s->n_people);
+    s->available = (int *)malloc(sizeof(int) * s->n_people);
+    if (s->cols_x == NULL || s->cols_y == NULL || s->bound_lit == NULL || s->active == NULL || s->available == NULL ||
+        session_grow_cells(s, s->row) != 0 || session_grow_scratch(s, s->row) != 0)
+        return 1;
+
+    for (size_t c = 0; c < s->cols_len; c++)
+    {
+        s->cols_x[c] = input->cols_x[c];
+        s->cols_y[c] = input->cols_y[c];
+        s->bound_lit[c] = mk_fresh_lit(s, "bound");
+    }
+    for (size_t i = 0; i < s->n_people; i++)
+    {
+        s->active[i] = mk_fresh_lit(s, "active");
+        s->available[i] = 1;
+    }
+    for (size_t r = 0; r < s->row; r++)
+    {
+        session_add_row_constraints(s, r);
+    }
+    session_add_shape_constraints(s);
+    return 0;
+}
+
+void schedule_session_set_available(schedule_session *s, size_t person, int available)
+{
+    s->available[person] = available;
+}
+
+/**
+   \brief Replace the bounds of room col. The old bounds are retired.
+*/
+void schedule_session_set_bounds(schedule_session *s, size_t col, size_t x, size_t y)
+{
+    Z3_context ctx = s->ctx;
+    Z3_solver_assert(ctx, s->solver, Z3_mk_not(ctx, s->bound_lit[col]));
+    s->bound_lit[col] = mk_fresh_lit(s, "bound");
+    s->cols_x[col] = x;
+    s->cols_y[col] = y;
+    for (size_t r = 0; r < s->row; r++)
+    {
+        for (size_t i = 0; i < s->n_people; i++)
+        {
+            s->scratch[i] = s->cells[session_cell(s, i, r, col)];
+        }
+        Z3_ast args[] = {
+            Z3_mk_atleast(ctx, s->n_people, s->scratch, x),
+            Z3_mk_atmost(ctx, s->n_people, s->scratch, y),
+        };
+        assert_guarded(s, s->bound_lit[col], Z3_mk_and(ctx, 2, args));
+    }
+}
+
+/**
+   \brief Append a row. Constraints local to a row are added, the row-spanning ones are rebuilt.
+
+   With more rows than rooms a person visits some rooms twice, see shape_lit.
+*/
+int schedule_session_add_row(schedule_session *s)
+{
+    // nothing changes unless both buffers can hold the new row
+    if (session_grow_cells(s, s->row + 1) != 0 || session_grow_scratch(s, s->row + 1) != 0)
+        return 1;
+    s->row++;
+    session_add_row_constraints(s, s->row - 1);
+    session_add_shape_constraints(s);
+    return 0;
+}
+
+/**
+   \brief Remember the values of the last model in s->prev.
+*/
+int session_store_model(schedule_session *s)
+{
+    Z3_model model = Z3_solver_get_model(s->ctx, s->solver);
+    for (size_t k = 0, len = s->row * s->n_people * s->cols_len; k < len; k++)
+    {
+        Z3_ast out;
+        if (Z3_model_eval(s->ctx, model, s->cells[k], true, &out) != Z3_L_TRUE)
+            return 2;
+        s->prev[k] = Z3_get_bool_value(s->ctx, out) == Z3_L_TRUE;
+    }
+    return 0;
+}
+
+/**
+   \brief Solve the current instance.
+
+   After the first solve, every assignment of the previous solution that is
+   still allowed is passed as an extra assumption. When they cannot all hold,
+   the ones in the unsat core are dropped and the check is repeated, so the
+   new solution keeps as much of the old one as the edit permits.
+*/
+int schedule_session_solve(schedule_session *s, schedule_result *result)
+{
+    if (init_schedule_result(result, s->n_people) != 0)
+        return 1;
+
+    size_t n_cells = s->row * s->n_people * s->cols_len;
+    size_t n_hard = s->n_people + s->cols_len + 1;
+    Z3_ast *assumptions = (Z3_ast *)malloc(sizeof(Z3_ast) * (n_hard + n_cells));
+    if (assumptions == NULL)
+        return 1;
+    size_t k = 0;
+    for (size_t i = 0; i < s->n_people; i++)
+    {
+        assumptions[k++] = s->available[i] ? s->active[i] : Z3_mk_not(s->ctx, s->active[i]);
+    }
+    for (size_t c = 0; c < s->cols_len; c++)
+    {
+        assumptions[k++] = s->bound_lit[c];
+    }
+    assumptions[k++] = s->shape_lit;
+    for (size_t p = 0; s->solved && p < n_cells; p++)
+    {
+        if (s->prev[p] == 1 && s->available[(p / s->cols_len) % s->n_people])
+            assumptions[k++] = s->cells[p];
+    }
+
+    Z3_lbool res = check_soft(s->ctx, s->solver, assumptions, n_hard, k - n_hard, NULL);
+    free(assumptions);
+
+    result->status = res;
+    if (res != Z3_L_TRUE)
+        return 0;
+    int ret = session_store_model(s);
+    if (ret != 0)
+        return ret;
+    s->solved = 1;
+
+    result->entries =
+        (schedule_entry *)arena_alloc(&result->arena, sizeof(schedule_entry) * (n_cells > 0 ? n_cells : 1));
+    if (result->entries == NULL)
+        return 1;
+    for (size_t i = 0; i < s->n_people; i++)
+    {
+        for (size_t r = 0; r < s->row; r++)
+        {
+            for (size_t c = 0; c < s->cols_len; c++)
+            {
+                if (!s->prev[session_cell(s, i, r, c)])
+                    continue;
+                schedule_entry *e = result->entries + result->entry_cnt++;
+                e->row = r;
+                e->col = c;
+                e->person = i;
+                e->name = result->names[i];
+            }
+        }
+    }
+    return 0;
+}
+
+void schedule_session_close(schedule_session *s)
+{
+    del_solver(s->ctx, s->solver);
+    Z3_del_context(s->ctx);
+    free(s->cols_x);
+    free(s->cols_y);
+    free(s->bound_lit);
+    free(s->active);
+    free(s->available);
+    free(s->cells);
+    free(s->prev);
+    free(s->scratch);
+    free(s->ones);
+    memset(s, 0, sizeof(schedule_session));
+}
@@ -0,0 +1,206 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+const char *PHASE_NAMES[N_PHASES] = {"construct", "anneal", "build", "check", "extract"};
+
+void telemetry_init(Telemetry *tel, size_t max_points)
+{
+    memset(tel, 0, sizeof(Telemetry));
+    tel->max_points = max_points;
+}
+
+void telemetry_free(Telemetry *tel)
+{
+    for (size_t i = 0; i < tel->n_stats; i++)
+    {
+        free(tel->stat_keys[i]);
+    }
+    free(tel->stat_keys);
+    free(tel->stat_values);
+    free(tel->trace);
+    free(tel->bests);
+    memset(tel, 0, sizeof(Telemetry));
+}
+
+// whether the engines were built with their recording hooks
+int telemetry_enabled()
+{
+#ifdef SCHED_TELEMETRY
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void telemetry_phase(Telemetry *tel, TelemetryPhase phase, double seconds)
+{
+    tel->phase_seconds[phase] += seconds;
+}
+
+// append p to the list, growing it up to tel->max_points
+void telemetry_append(Telemetry *tel, TelemetryPoint **list, size_t *len, size_t *cap, const TelemetryPoint *p)
+{
+    if (*len == *cap)
+    {
+        size_t grown_cap = *cap == 0 ? 64 : *cap * 2;
+        if (grown_cap > tel->max_points)
+            grown_cap = tel->max_points;
+        TelemetryPoint *grown = *len < grown_cap ? (TelemetryPoint *)realloc(*list, sizeof(TelemetryPoint) * grown_cap) : NULL;
+        if (grown == NULL)
+        {
+            tel->dropped++;
+            return;
+        }
+        *list = grown;
+        *cap = grown_cap;
+    }
+    (*list)[(*len)++] = *p;
+}
+
+void telemetry_point(Telemetry *tel, const TelemetryPoint *p)
+{
+    telemetry_append(tel, &tel->trace, &tel->trace_len, &tel->trace_cap, p);
+}
+
+void telemetry_best(Telemetry *tel, const TelemetryPoint *p)
+{
+    telemetry_append(tel, &tel->bests, &tel->bests_len, &tel->bests_cap, p);
+}
+
+// a key that is set again keeps its latest value
+int telemetry_stat(Telemetry *tel, const char *key, double value)
+{
+    for (size_t i = 0; i < tel->n_stats; i++)
+    {
+        if (strcmp(tel->stat_keys[i], key) == 0)
+        {
+            tel->stat_values[i] = value;
+            return 0;
+        }
+    }
+    char **keys = (char **)realloc(tel->stat_keys, sizeof(char *) * (tel->n_stats + 1));
+    if (keys == NULL)
+        return 2;
+    tel->stat_keys = keys;
+    double *values = (double *)realloc(tel->stat_values, sizeof(double) * (tel->n_stats + 1));
+    if (values == NULL)
+        return 2;
+    tel->stat_values = values;
+    char *copy = (char *)malloc(strlen(key) + 1);
+    if (copy == NULL)
+        return 2;
+    strcpy(copy, key);
+    keys[tel->n_stats] = copy;
+    values[tel->n_stats] = value;
+    tel->n_stats++;
+    return 0;
+}
+
+void telemetry_json_string(FILE *out, const char *s)
+{
+    fputc('"', out);
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', out);
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+void telemetry_json_points(FILE *out, const TelemetryPoint *points, size_t len)
+{
+    fputc('[', out);
+    for (size_t i = 0; i < len; i++)
+    {
+        const TelemetryPoint *p = points + i;
+        fprintf(out, "%s{\"s\":%.6f,\"step\":%zu,\"energy\":%zu,\"best\":%zu,\"temperature\":%.6g,\"acceptance\":%.4f}",
+                i == 0 ? "" : ",", p->seconds, p->step, p->energy, p->best, p->temperature, p->acceptance);
+    }
+    fputc(']', out);
+}
+
+// iterations per second of the annealing phase, 0 when it was not timed
+double telemetry_rate(const Telemetry *tel)
+{
+    return tel->phase_seconds[PHASE_ANNEAL] > 0 ? tel->steps / tel->phase_seconds[PHASE_ANNEAL] : 0;
+}
+
+void telemetry_write_json(const Telemetry *tel, FILE *out)
+{
+    fprintf(out, "{\"trajectory\":%d,\"phases\":{", telemetry_enabled());
+    for (int k = 0; k < N_PHASES; k++)
+    {
+        fprintf(out, "%s\"%s\":%.6f", k == 0 ? "" : ",", PHASE_NAMES[k], tel->phase_seconds[k]);
+    }
+    fprintf(out, "},\"anneal\":{\"steps\":%zu,\"epochs\":%zu,\"steps_per_s\":%.1f,\"acceptance\":%.4f,\"dropped\":%zu,",
+            tel->steps, tel->epochs, telemetry_rate(tel), tel->steps > 0 ? (double)tel->accepted / tel->steps : 0.0,
+            tel->dropped);
+    fprintf(out, "\"trace\":");
+    telemetry_json_points(out, tel->trace, tel->trace_len);
+    fprintf(out, ",\"bests\":");
+    telemetry_json_points(out, tel->bests, tel->bests_len);
+    fprintf(out, "},\"stats\":{");
+    for (size_t i = 0; i < tel->n_stats; i++)
+    {
+        if (i > 0)
+            fputc(',', out);
+        telemetry_json_string(out, tel->stat_keys[i]);
+        fprintf(out, ":%.17g", tel->stat_values[i]);
+    }
+    fprintf(out, "}}\n");
+}
+
+void telemetry_csv_points(FILE *out, const char *kind, const TelemetryPoint *points, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        const TelemetryPoint *p = points + i;
+        fprintf(out, "%s,,,%.6f,%zu,%zu,%zu,%.6g,%.4f\n", kind, p->seconds, p->step, p->energy, p->best,
+                p->temperature, p->acceptance);
+    }
+}
+
+// one record per line: phases, counters and statistics fill name and value,
+// trace and best points the remaining columns
+void telemetry_write_csv(const Telemetry *tel, FILE *out)
+{
+    fprintf(out, "kind,name,value,seconds,step,energy,best,temperature,acceptance\n");
+    for (int k = 0; k < N_PHASES; k++)
+    {
+        fprintf(out, "phase,%s,%.6f,,,,,,\n", PHASE_NAMES[k], tel->phase_seconds[k]);
+    }
+    fprintf(out, "counter,steps,%zu,,,,,,\n", tel->steps);
+    fprintf(out, "counter,accepted,%zu,,,,,,\n", tel->accepted);
+    fprintf(out, "counter,epochs,%zu,,,,,,\n", tel->epochs);
+    fprintf(out, "counter,steps_per_s,%.1f,,,,,,\n", telemetry_rate(tel));
+    fprintf(out, "counter,dropped,%zu,,,,,,\n", tel->dropped);
+    for (size_t i = 0; i < tel->n_stats; i++)
+    {
+        fprintf(out, "stat,%s,%.17g,,,,,,\n", tel->stat_keys[i], tel->stat_values[i]);
+    }
+    telemetry_csv_points(out, "epoch", tel->trace, tel->trace_len);
+    telemetry_csv_points(out, "best", tel->bests, tel->bests_len);
+}
+
+// write tel to path, as CSV when the name ends in ".csv" and as JSON
+// otherwise; "-" writes JSON to stdout
+int telemetry_write(const Telemetry *tel, const char *path)
+{
+    if (strcmp(path, "-") == 0)
+    {
+        telemetry_write_json(tel, stdout);
+        return 0;
+    }
+    FILE *out = fopen(path, "w");
+    if (out == NULL)
+        return 1;
+    size_t len = strlen(path);
+    if (len >= 4 && strcmp(path + len - 4, ".csv") == 0)
+        telemetry_write_csv(tel, out);
+    else
+        telemetry_write_json(tel, out);
+    return fclose(out) == 0 ? 0 : 1;
+}
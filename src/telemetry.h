@@ -0,0 +1,75 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Run telemetry: phase timings, annealing counters, the energy trajectory,
+// the times at which new bests were found, and solver statistics as
+// key/value pairs. Timings and counters are added once per run. The hooks
+// that record the trajectory sit inside the engines' loops, so they are
+// wrapped in TELEMETRY() and compile to nothing unless SCHED_TELEMETRY is
+// defined. A Telemetry belongs to one run and is not shared between threads.
+
+// #define SCHED_TELEMETRY
+
+#ifdef SCHED_TELEMETRY
+#define TELEMETRY(...) __VA_ARGS__
+#else
+#define TELEMETRY(...)
+#endif
+
+typedef enum TelemetryPhase
+{
+    PHASE_CONSTRUCT,
+    PHASE_ANNEAL,
+    PHASE_BUILD,
+    PHASE_CHECK,
+    PHASE_EXTRACT,
+    N_PHASES
+} TelemetryPhase;
+
+typedef struct TelemetryPoint
+{
+    /// seconds since the start of the run
+    double seconds;
+    size_t step;
+    size_t energy;
+    size_t best;
+    double temperature;
+    /// share of the moves accepted in the epoch that ends here
+    double acceptance;
+} TelemetryPoint;
+
+typedef struct Telemetry
+{
+    double phase_seconds[N_PHASES];
+    size_t steps;
+    size_t accepted;
+    size_t epochs;
+    /// one point at the end of every epoch
+    TelemetryPoint *trace;
+    size_t trace_len, trace_cap;
+    /// one point for every new best energy
+    TelemetryPoint *bests;
+    size_t bests_len, bests_cap;
+    /// points kept in each list, later ones are counted in dropped
+    size_t max_points;
+    size_t dropped;
+    size_t n_stats;
+    char **stat_keys;
+    double *stat_values;
+} Telemetry;
+
+void telemetry_init(Telemetry *tel, size_t max_points);
+void telemetry_free(Telemetry *tel);
+int telemetry_enabled();
+void telemetry_phase(Telemetry *tel, TelemetryPhase phase, double seconds);
+void telemetry_point(Telemetry *tel, const TelemetryPoint *p);
+void telemetry_best(Telemetry *tel, const TelemetryPoint *p);
+int telemetry_stat(Telemetry *tel, const char *key, double value);
+void telemetry_write_json(const Telemetry *tel, FILE *out);
+void telemetry_write_csv(const Telemetry *tel, FILE *out);
+int telemetry_write(const Telemetry *tel, const char *path);
+
+#endif